@@ -0,0 +1,168 @@
+#!/bin/sh
+
+#
+# Benchmark mon(1) against the synthetic children of
+# bench/child, run with `make bench`. Compare builds with
+# MON=/path/to/other/mon make bench.
+#
+#   BENCH_TIME      seconds of each crash loop [5]
+#   BENCH_LINES     lines written through the capture path [200000]
+#   BENCH_CHILDREN  idle children supervised at once [100]
+#   BENCH_MAX_MEM   anonymous memory limit in kb [400]
+#
+
+MON=${MON:-./mon}
+CHILD=./bench/child
+TIME=${BENCH_TIME:-5}
+LINES=${BENCH_LINES:-200000}
+CHILDREN=${BENCH_CHILDREN:-100}
+MAX_MEM=${BENCH_MAX_MEM:-400}
+HZ=$(getconf CLK_TCK)
+TMP=$(mktemp -d /tmp/mon-bench.XXXXXX)
+status=0
+
+trap 'rm -rf $TMP' EXIT
+
+# monotonic-enough wall clock in ms
+
+now() {
+  echo $(($(date +%s%N) / 1000000))
+}
+
+# anonymous memory of pid $1 in kb, which unlike private
+# memory doesn't shrink while shared with a forked child
+
+anon() {
+  awk '/^RssAnon:/ { print $2 }' /proc/$1/status
+}
+
+# cpu ticks used by pid $1
+
+ticks() {
+  awk '{ print $14 + $15 }' /proc/$1/stat
+}
+
+# cpu percentage of $1 ticks over BENCH_TIME
+
+cpu() {
+  printf "  %-24s %s%%\n" "mon cpu" $(echo $1 $HZ $TIME | awk '{ printf "%.1f", $1 / $2 / $3 * 100 }')
+}
+
+# wait until the last line of the child is in file $1, or 30s
+
+wait_last() {
+  last=$(printf "line %06d" $((LINES - 1)))
+  for i in $(seq 3000); do
+    tail -c 512 $1 2>/dev/null | grep -q "$last" && return 0
+    sleep 0.01
+  done
+  echo "  FAIL: $1 is missing lines"
+  status=1
+}
+
+# stop mon(1) pid $1
+
+stop() {
+  kill $1 2>/dev/null
+  wait $1 2>/dev/null
+}
+
+# fail when pid $1 uses BENCH_MAX_MEM or more
+
+guard() {
+  kb=$(anon $1)
+  printf "  %-24s %d kb\n" "$2" $kb
+  if [ $kb -ge $MAX_MEM ]; then
+    echo "  FAIL: $2 uses ${kb}kb, more than ${MAX_MEM}kb"
+    status=1
+  fi
+}
+
+#
+# Restart latency, from the exit of a child to the start
+# of the next one, and spawn throughput of a crash loop.
+#
+
+echo
+echo "  crash loop (${TIME}s)"
+echo
+
+$MON -y 1:now -a 1000 -w 100ms "$CHILD crash $TMP/stamps" > /dev/null &
+pid=$!
+sleep 0.5
+guard $pid "memory before"
+before=$(ticks $pid)
+sleep $TIME
+after=$(ticks $pid)
+guard $pid "memory after"
+stop $pid
+
+sort -n $TMP/stamps | awk '
+  NR > 1 { print int(($1 - last) / 1000) }
+  { last = $2 }' | sort -n > $TMP/latency
+
+awk '
+  NR == 1 { first = $1 }
+  { last = $2 }
+  END { printf "  %-24s %d/s\n", "spawns", NR / ((last - first) / 1e9) }' $TMP/stamps
+
+awk '
+  { lat[NR] = $1 }
+  END {
+    printf "  %-24s %dus\n", "latency p50", lat[int(NR * .50) + 1]
+    printf "  %-24s %dus\n", "latency p90", lat[int(NR * .90) + 1]
+    printf "  %-24s %dus\n", "latency p99", lat[int(NR * .99) + 1]
+    printf "  %-24s %dus\n", "latency max", lat[NR]
+  }' $TMP/latency
+
+cpu $((after - before))
+
+#
+# Log throughput through the tagged capture path,
+# and the splice() path of daemonized children.
+#
+
+echo
+echo "  logs ($LINES lines)"
+echo
+
+start=$(now)
+$MON -t "$CHILD log $LINES" > $TMP/tag.log &
+pid=$!
+wait_last $TMP/tag.log
+ms=$(($(now) - start))
+stop $pid
+printf "  %-24s %d lines/s\n" "tagged" $((LINES * 1000 / (ms ? ms : 1)))
+
+start=$(now)
+$MON -d -m $TMP/mon.pid -l $TMP/splice.log "$CHILD log $LINES"
+wait_last $TMP/splice.log
+ms=$(($(now) - start))
+kill $(tr -d '\0' < $TMP/mon.pid)
+printf "  %-24s %d lines/s\n" "spliced" $((LINES * 1000 / (ms ? ms : 1)))
+
+#
+# Memory and cpu of mon(1) itself while supervising
+# many idle children.
+#
+
+echo
+echo "  $CHILDREN children"
+echo
+
+for i in $(seq $CHILDREN); do
+  printf "[child%d]\ncmd %s idle\n" $i $CHILD
+done > $TMP/mon.conf
+
+$MON -i $TMP/mon.conf > /dev/null &
+pid=$!
+sleep 1
+before=$(ticks $pid)
+sleep $TIME
+after=$(ticks $pid)
+printf "  %-24s %d kb\n" "memory" $(anon $pid)
+cpu $((after - before))
+stop $pid
+
+echo
+exit $status
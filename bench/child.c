@@ -0,0 +1,83 @@
+//
+// child.c
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+/*
+ * Synthetic child supervised by bench/bench.sh:
+ *
+ *   child crash <file>   append "<started> <exiting>" in ns to <file> and exit(1)
+ *   child log <n>        write <n> 100 byte lines to stdout, then idle
+ *   child idle           idle until killed
+ */
+
+/*
+ * Return monotonic time in nanoseconds.
+ */
+
+static long long
+now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * Append the start and exit times to `path` with a
+ * single write, so that lines never interleave.
+ */
+
+static void
+crash(const char *path, long long started) {
+  char buf[64];
+  int fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+  if (-1 == fd) {
+    perror("open()");
+    exit(2);
+  }
+
+  int n = snprintf(buf, sizeof(buf), "%lld %lld\n", started, now());
+  if (n != write(fd, buf, n)) perror("write()");
+  exit(1);
+}
+
+/*
+ * Write `n` lines to stdout.
+ */
+
+static void
+lines(int n) {
+  char line[101];
+  memset(line, 'x', sizeof(line) - 1);
+  line[sizeof(line) - 1] = '\n';
+
+  for (int i = 0; i < n; ++i) {
+    snprintf(line, 12, "line %06d", i);
+    line[11] = ' ';
+    fwrite(line, 1, sizeof(line), stdout);
+  }
+
+  fflush(stdout);
+}
+
+int
+main(int argc, char **argv) {
+  long long started = now();
+
+  if (argc > 2 && !strcmp("crash", argv[1])) crash(argv[2], started);
+  if (argc > 2 && !strcmp("log", argv[1])) lines(atoi(argv[2]));
+  else if (argc < 2 || strcmp("idle", argv[1])) {
+    fprintf(stderr, "usage: child crash <file> | log <n> | idle\n");
+    exit(2);
+  }
+
+  for (;;) pause();
+}
@@ -0,0 +1,85 @@
+//
+// ms.c
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ms.h"
+
+/*
+ * Iterations per benchmark.
+ */
+
+#define TIMES 1000000
+
+/*
+ * Return monotonic time in nanoseconds.
+ */
+
+static long long
+now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * Output ns per op of `name` started at `start`.
+ */
+
+static void
+report(const char *name, long long start) {
+  printf("  %-32s %.1f ns/op\n", name, (double) (now() - start) / TIMES);
+}
+
+int
+main() {
+  char buf[MS_LEN];
+  long long start;
+  volatile char c = 0;
+
+  printf("\n  ms (%d times)\n\n", TIMES);
+
+  start = now();
+  for (int i = 0; i < TIMES; ++i) {
+    char *str = milliseconds_to_string(i * 37LL);
+    c ^= str[0];
+    free(str);
+  }
+  report("milliseconds_to_string", start);
+
+  start = now();
+  for (int i = 0; i < TIMES; ++i) {
+    c ^= milliseconds_to_string_r(i * 37LL, buf, sizeof(buf))[0];
+  }
+  report("milliseconds_to_string_r", start);
+
+  start = now();
+  for (int i = 0; i < TIMES; ++i) {
+    char *str = milliseconds_to_long_string(i * 37LL);
+    c ^= str[0];
+    free(str);
+  }
+  report("milliseconds_to_long_string", start);
+
+  start = now();
+  for (int i = 0; i < TIMES; ++i) {
+    c ^= milliseconds_to_long_string_r(i * 37LL, buf, sizeof(buf))[0];
+  }
+  report("milliseconds_to_long_string_r", start);
+
+  start = now();
+  for (int i = 0; i < TIMES; ++i) {
+    buf[0] = '1' + i % 9;
+    buf[1] = 's';
+    buf[2] = 0;
+    c ^= string_to_milliseconds(buf);
+  }
+  report("string_to_milliseconds", start);
+
+  printf("\n");
+  return 0;
+}
@@ -83,14 +83,12 @@ string_to_seconds(const char *str) {
 }
 
 /*
- * Convert the given `ms` to a string. This
- * value must be `free()`d by the developer.
+ * Convert the given `ms` to a string in `buf`
+ * of `len` bytes, returning `buf`.
  */
 
 char *
-milliseconds_to_string(long long ms) {
-  char *str = malloc(MS_MAX);
-  if (!str) return NULL;
+milliseconds_to_string_r(long long ms, char *buf, size_t len) {
   long div = 1;
   char *fmt;
 
@@ -101,27 +99,36 @@ milliseconds_to_string(long long ms) {
   else if (ms < MS_WEEK) { fmt = "%lldd"; div = MS_DAY; }
   else if (ms < MS_YEAR) { fmt = "%lldw"; div = MS_WEEK; }
   else { fmt = "%lldy"; div = MS_YEAR; }
-  snprintf(str, MS_MAX, fmt, ms / div);
+  snprintf(buf, len, fmt, ms / div);
 
-  return str;
+  return buf;
 }
 
 /*
- * Convert the given `ms` to a long string. This
+ * Convert the given `ms` to a string. This
  * value must be `free()`d by the developer.
  */
 
 char *
-milliseconds_to_long_string(long long ms) {
-  long div;
-  char *name;
-
+milliseconds_to_string(long long ms) {
   char *str = malloc(MS_MAX);
   if (!str) return NULL;
+  return milliseconds_to_string_r(ms, str, MS_MAX);
+}
+
+/*
+ * Convert the given `ms` to a long string in
+ * `buf` of `len` bytes, returning `buf`.
+ */
+
+char *
+milliseconds_to_long_string_r(long long ms, char *buf, size_t len) {
+  long div;
+  char *name;
 
   if (ms < MS_SEC) {
-    sprintf(str, "less than one second");
-    return str;
+    snprintf(buf, len, "less than one second");
+    return buf;
   }
 
   if (ms < MS_MIN) { name = "second"; div = MS_SEC; }
@@ -136,106 +143,18 @@ milliseconds_to_long_string(long long ms) {
     ? "%lld %s"
     : "%lld %ss";
 
-  snprintf(str, MS_MAX, fmt, val, name);
-  return str;
-}
-
-// tests
-
-#ifdef TEST_MS
-
-#include <assert.h>
-
-void
-equal(char *a, char *b) {
-  if (strcmp(a, b)) {
-    printf("expected: %s\n", a);
-    printf("actual: %s\n", b);
-    exit(1);
-  }
-}
-
-void
-test_string_to_microseconds() {
-  assert(string_to_microseconds("") == -1);
-  assert(string_to_microseconds("s") == -1);
-  assert(string_to_microseconds("hey") == -1);
-  assert(string_to_microseconds("5000") == 5000);
-  assert(string_to_microseconds("1ms") == 1000);
-  assert(string_to_microseconds("5ms") == 5000);
-  assert(string_to_microseconds("1s") == 1000000);
-  assert(string_to_microseconds("5s") == 5000000);
-  assert(string_to_microseconds("1m") == 60000000);
-  assert(string_to_microseconds("1h") == 3600000000);
-  assert(string_to_microseconds("2d") == 2 * 24 * 3600000000);
-}
-
-void
-test_string_to_milliseconds() {
-  assert(string_to_milliseconds("") == -1);
-  assert(string_to_milliseconds("s") == -1);
-  assert(string_to_milliseconds("hey") == -1);
-  assert(string_to_milliseconds("5000") == 5000);
-  assert(string_to_milliseconds("1ms") == 1);
-  assert(string_to_milliseconds("5ms") == 5);
-  assert(string_to_milliseconds("1s") == 1000);
-  assert(string_to_milliseconds("5s") == 5000);
-  assert(string_to_milliseconds("1m") == 60 * 1000);
-  assert(string_to_milliseconds("1h") == 60 * 60 * 1000);
-  assert(string_to_milliseconds("1d") == 24 * 60 * 60 * 1000);
-}
-
-void
-test_string_to_seconds() {
-  assert(string_to_seconds("") == -1);
-  assert(string_to_seconds("s") == -1);
-  assert(string_to_seconds("hey") == -1);
-  assert(string_to_seconds("5000") == 5);
-  assert(string_to_seconds("1ms") == 0);
-  assert(string_to_seconds("5ms") == 0);
-  assert(string_to_seconds("1s") == 1);
-  assert(string_to_seconds("5s") == 5);
-  assert(string_to_seconds("1m") == 60);
-  assert(string_to_seconds("1h") == 60 * 60);
-  assert(string_to_seconds("1d") == 24 * 60 * 60);
-}
-
-void
-test_milliseconds_to_string() {
-  equal("500ms", milliseconds_to_string(500));
-  equal("5s", milliseconds_to_string(5000));
-  equal("2s", milliseconds_to_string(2500));
-  equal("1m", milliseconds_to_string(MS_MIN));
-  equal("5m", milliseconds_to_string(5 * MS_MIN));
-  equal("1h", milliseconds_to_string(MS_HOUR));
-  equal("2d", milliseconds_to_string(2 * MS_DAY));
-  equal("2w", milliseconds_to_string(15 * MS_DAY));
-  equal("3y", milliseconds_to_string(3 * MS_YEAR));
+  snprintf(buf, len, fmt, val, name);
+  return buf;
 }
 
-void
-test_milliseconds_to_long_string() {
-  equal("less than one second", milliseconds_to_long_string(500));
-  equal("5 seconds", milliseconds_to_long_string(5000));
-  equal("2 seconds", milliseconds_to_long_string(2500));
-  equal("1 minute", milliseconds_to_long_string(MS_MIN));
-  equal("5 minutes", milliseconds_to_long_string(5 * MS_MIN));
-  equal("1 hour", milliseconds_to_long_string(MS_HOUR));
-  equal("2 days", milliseconds_to_long_string(2 * MS_DAY));
-  equal("2 weeks", milliseconds_to_long_string(15 * MS_DAY));
-  equal("1 year", milliseconds_to_long_string(MS_YEAR));
-  equal("3 years", milliseconds_to_long_string(3 * MS_YEAR));
-}
+/*
+ * Convert the given `ms` to a long string. This
+ * value must be `free()`d by the developer.
+ */
 
-int
-main(){
-  test_string_to_microseconds();
-  test_string_to_milliseconds();
-  test_string_to_seconds();
-  test_milliseconds_to_string();
-  test_milliseconds_to_long_string();
-  printf("\n  \e[32m\u2713 \e[90mok\e[0m\n\n");
-  return 0;
+char *
+milliseconds_to_long_string(long long ms) {
+  char *str = malloc(MS_MAX);
+  if (!str) return NULL;
+  return milliseconds_to_long_string_r(ms, str, MS_MAX);
 }
-
-#endif
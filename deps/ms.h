@@ -8,12 +8,18 @@
 #ifndef MS
 #define MS
 
+#include <stddef.h>
+
 // max buffer length
 
 #ifndef MS_MAX
 #define MS_MAX 256
 #endif
 
+// buffer length fitting any formatted duration
+
+#define MS_LEN 32
+
 // prototypes
 
 long long
@@ -28,7 +34,13 @@ string_to_seconds(const char *str);
 char *
 milliseconds_to_string(long long ms);
 
+char *
+milliseconds_to_string_r(long long ms, char *buf, size_t len);
+
 char *
 milliseconds_to_long_string(long long ms);
 
+char *
+milliseconds_to_long_string_r(long long ms, char *buf, size_t len);
+
 #endif
\ No newline at end of file
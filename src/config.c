@@ -0,0 +1,178 @@
+//
+// config.c
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <libgen.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "config.h"
+#include "mon.h"
+
+/*
+ * Inotify watcher and the file watched.
+ */
+
+static loop_io_t watcher;
+static char *watched;
+static config_cb_t reload;
+
+/*
+ * Trim whitespace around `str` in place.
+ */
+
+static char *
+trim(char *str) {
+  while (' ' == *str || '\t' == *str) str++;
+  char *end = str + strlen(str);
+  while (end > str && strchr(" \t\r", end[-1])) *--end = '\0';
+  return str;
+}
+
+/*
+ * Read the config file at `path` into `config`, returning
+ * -1 and outputting the error on failure. The format is
+ * an option per line, named as its long flag without the
+ * dashes, optionally followed by its value. Options
+ * preceding the first "[name]" section apply to every
+ * section, each section being a service with its own "cmd":
+ *
+ *   sleep 2s
+ *
+ *   [app]
+ *   cmd ./server --port 3000
+ *   health tcp::3000
+ *
+ * Lines starting with "#" are comments.
+ */
+
+int
+config_read(const char *path, config_t *config) {
+  FILE *file = fopen(path, "r");
+  struct stat st;
+
+  if (!file || -1 == fstat(fileno(file), &st)) {
+    fprintf(stderr, "Error: %s: %s\n", path, strerror(errno));
+    if (file) fclose(file);
+    return -1;
+  }
+
+  config->data = malloc(st.st_size + 1);
+  config->entries = NULL;
+  config->len = 0;
+  if (!config->data) error("out of memory");
+
+  size_t n = fread(config->data, 1, st.st_size, file);
+  config->data[n] = '\0';
+  fclose(file);
+
+  const char *section = NULL;
+  int cap = 0;
+  int line = 0;
+
+  for (char *next, *str = config->data; str; str = next) {
+    next = strchr(str, '\n');
+    if (next) *next++ = '\0';
+    line++;
+
+    str = trim(str);
+    if (!*str || '#' == *str) continue;
+
+    // [section]
+    if ('[' == *str) {
+      char *end = strchr(str, ']');
+      if (!end || end[1]) {
+        fprintf(stderr, "Error: %s:%d: invalid section `%s`\n", path, line, str);
+        config_free(config);
+        return -1;
+      }
+      *end = '\0';
+      section = trim(str + 1);
+      continue;
+    }
+
+    // key [value]
+    char *value = str + strcspn(str, " \t");
+    if (*value) *value++ = '\0';
+
+    if (config->len == cap) {
+      cap = cap ? cap * 2 : 32;
+      config->entries = realloc(config->entries, cap * sizeof(config_entry_t));
+      if (!config->entries) error("out of memory");
+    }
+
+    config_entry_t *entry = &config->entries[config->len++];
+    entry->section = section;
+    entry->key = str;
+    entry->value = trim(value);
+    entry->line = line;
+  }
+
+  return 0;
+}
+
+/*
+ * Free `config`.
+ */
+
+void
+config_free(config_t *config) {
+  free(config->entries);
+  free(config->data);
+}
+
+/*
+ * Config file changed.
+ */
+
+static void
+on_change(loop_io_t *io, uint32_t events) {
+  char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  int changed = 0;
+  ssize_t n;
+
+  while ((n = read(io->fd, buf, sizeof(buf))) > 0) {
+    for (char *p = buf; p < buf + n; ) {
+      struct inotify_event *event = (struct inotify_event *) p;
+      if (event->len && !strcmp(watched, event->name)) changed = 1;
+      p += sizeof(struct inotify_event) + event->len;
+    }
+  }
+
+  if (changed) reload();
+}
+
+/*
+ * Invoke `cb` whenever the config file at `path` is
+ * written or replaced. The directory is watched, as
+ * editors commonly rename a new file over the old.
+ */
+
+void
+config_watch(const char *path, config_cb_t cb) {
+  char *dir = strdup(path);
+  char *base = strdup(path);
+  if (!dir || !base) error("out of memory");
+
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (-1 == fd) {
+    perror("inotify_init1()");
+    exit(1);
+  }
+
+  if (-1 == inotify_add_watch(fd, dirname(dir), IN_CLOSE_WRITE | IN_MOVED_TO)) {
+    perror("inotify_add_watch()");
+    exit(1);
+  }
+
+  watched = basename(base);
+  reload = cb;
+  loop_add(&watcher, fd, EPOLLIN, on_change, NULL);
+  free(dir);
+}
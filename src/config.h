@@ -0,0 +1,49 @@
+//
+// config.h
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+/*
+ * Config entry, an option of the section
+ * named `section` or NULL before the first.
+ */
+
+typedef struct {
+  const char *section;
+  const char *key;
+  const char *value;
+  int line;
+} config_entry_t;
+
+/*
+ * Parsed config file.
+ */
+
+typedef struct {
+  char *data;
+  config_entry_t *entries;
+  int len;
+} config_t;
+
+/*
+ * Config reload callback.
+ */
+
+typedef void (* config_cb_t)();
+
+// prototypes
+
+int
+config_read(const char *path, config_t *config);
+
+void
+config_free(config_t *config);
+
+void
+config_watch(const char *path, config_cb_t cb);
+
+#endif /* CONFIG_H */
@@ -0,0 +1,346 @@
+//
+// control.c
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "control.h"
+#include "mon.h"
+
+/*
+ * Control connection.
+ */
+
+typedef struct {
+  loop_io_t io;
+  char in[CONTROL_MAX_REQUEST];
+  size_t inlen;
+  buffer_t out;
+  size_t off;
+} conn_t;
+
+/*
+ * Listening socket.
+ */
+
+static const char *socket_path = NULL;
+static loop_io_t listener;
+
+/*
+ * Append formatted output to `buf`.
+ */
+
+void
+buffer_printf(buffer_t *buf, const char *fmt, ...) {
+  va_list args;
+
+  for (;;) {
+    size_t avail = buf->cap - buf->len;
+    va_start(args, fmt);
+    int n = vsnprintf(buf->data + buf->len, avail, fmt, args);
+    va_end(args);
+    if (n < 0) return;
+
+    if (n < avail) {
+      buf->len += n;
+      return;
+    }
+
+    size_t cap = buf->cap ? buf->cap * 2 : 1024;
+    while (cap - buf->len <= n) cap *= 2;
+    char *data = realloc(buf->data, cap);
+    if (!data) return;
+    buf->data = data;
+    buf->cap = cap;
+  }
+}
+
+/*
+ * Write the service name of `monitor` into `buf`,
+ * safe for tab-separated output.
+ */
+
+static void
+service_name(monitor_t *monitor, char *buf, size_t len) {
+  const char *p = monitor_prefix(monitor);
+  snprintf(buf, len, "%s", p ? p : monitor->cmd);
+  for (char *c = buf; *c; ++c) if ('\t' == *c || '\n' == *c) *c = ' ';
+}
+
+/*
+ * Return the state of `monitor`.
+ */
+
+static const char *
+state_of(monitor_t *monitor) {
+  if (monitor->bailed) return "bailed";
+  if (monitor->stopped) return "stopped";
+  if (monitor->pid && !monitor->ready_at) return "starting";
+  if (monitor->pid) return "running";
+  return "restarting";
+}
+
+/*
+ * Describe the last exit of `monitor` into `buf`.
+ */
+
+static void
+last_exit(monitor_t *monitor, char *buf, size_t len) {
+  int status = monitor->last_status;
+  if (!monitor->exits) snprintf(buf, len, "-");
+  else if (WIFSIGNALED(status)) snprintf(buf, len, "signal(%s)", strsignal(WTERMSIG(status)));
+  else snprintf(buf, len, "exit(%d)", WEXITSTATUS(status));
+}
+
+/*
+ * Respond to "status" with a tab-separated line per
+ * monitor: service, pid, state, start time in seconds
+ * since the epoch, uptime in ms, restarts and last exit.
+ */
+
+static void
+status(buffer_t *out) {
+  int64_t now = timestamp();
+  char name[256];
+  char exit[64];
+
+  for (monitor_t *m = monitors; m; m = m->next) {
+    service_name(m, name, sizeof(name));
+    last_exit(m, exit, sizeof(exit));
+
+    buffer_printf(out, "%s\t%d\t%s\t%lld\t%lld\t%d\t%s\n"
+      , name
+      , m->pid
+      , state_of(m)
+      , m->pid ? (long long) m->started_time : 0LL
+      , m->pid ? (long long) (now - m->started_at) : 0LL
+      , m->restarts_total
+      , exit);
+  }
+}
+
+/*
+ * Output `run` of service `name` tab-separated.
+ */
+
+static void
+run_line(buffer_t *out, const char *name, const char *kind, run_t *run) {
+  buffer_printf(out, "%s\t%s\t%lld\t%lld\t%d\t%lld\t%lld\t%ld\t%ld\t%ld\t%ld\t%ld\n"
+    , name
+    , kind
+    , (long long) run->started
+    , (long long) run->duration
+    , run->status
+    , (long long) run->utime
+    , (long long) run->stime
+    , run->maxrss
+    , run->minflt
+    , run->majflt
+    , run->nvcsw
+    , run->nivcsw);
+}
+
+/*
+ * Respond to "history" with a tab-separated line per
+ * recent run of each monitor, oldest first, followed by
+ * lifetime totals: service, "run" or "total", start time,
+ * duration in ms, wait status, user and system CPU in
+ * microseconds, max RSS in kb, minor and major faults,
+ * voluntary and involuntary context switches.
+ */
+
+static void
+history(buffer_t *out) {
+  char name[256];
+
+  for (monitor_t *m = monitors; m; m = m->next) {
+    service_name(m, name, sizeof(name));
+
+    for (int i = 0; i < MON_HISTORY; ++i) {
+      run_t *run = &m->runs[(m->runs_head + i) % MON_HISTORY];
+      if (run->started) run_line(out, name, "run", run);
+    }
+
+    run_line(out, name, "total", &m->totals);
+  }
+}
+
+/*
+ * Respond to "handover [service]" by handing the named
+ * monitor, or all of them, over to a new generation,
+ * with "ok" and the number of handovers started.
+ */
+
+static void
+handover_all(buffer_t *out, const char *service) {
+  char name[256];
+  int n = 0;
+
+  for (monitor_t *m = monitors; m; m = m->next) {
+    service_name(m, name, sizeof(name));
+    if (service && strcmp(service, name)) continue;
+    n += handover(m);
+  }
+
+  buffer_printf(out, "ok\t%d\n", n);
+}
+
+/*
+ * Dispatch request `req` of `conn`.
+ */
+
+static void
+dispatch(conn_t *conn, const char *req) {
+  if (!strcmp("status", req)) status(&conn->out);
+  else if (!strcmp("metrics", req)) metrics_render(&conn->out);
+  else if (!strcmp("history", req)) history(&conn->out);
+  else if (!strcmp("handover", req)) handover_all(&conn->out, NULL);
+  else if (!strncmp("handover ", req, 9)) handover_all(&conn->out, req + 9);
+  else buffer_printf(&conn->out, "error\tunknown request `%s`\n", req);
+}
+
+/*
+ * Close `conn`.
+ */
+
+static void
+conn_close(conn_t *conn) {
+  loop_remove(&conn->io);
+  close(conn->io.fd);
+  free(conn->out.data);
+  free(conn);
+}
+
+/*
+ * Write the response of `conn`, closing it once written.
+ */
+
+static void
+conn_write(conn_t *conn) {
+  while (conn->off < conn->out.len) {
+    ssize_t n = write(conn->io.fd, conn->out.data + conn->off, conn->out.len - conn->off);
+    if (-1 == n) {
+      if (EINTR == errno) continue;
+      if (EAGAIN == errno) {
+        loop_modify(&conn->io, EPOLLOUT);
+        return;
+      }
+      break;
+    }
+    conn->off += n;
+  }
+
+  conn_close(conn);
+}
+
+/*
+ * Connection readable or writable.
+ */
+
+static void
+on_conn(loop_io_t *io, uint32_t events) {
+  conn_t *conn = io->data;
+
+  if (conn->out.len) {
+    conn_write(conn);
+    return;
+  }
+
+  ssize_t n = read(io->fd, conn->in + conn->inlen, sizeof(conn->in) - conn->inlen - 1);
+  if (-1 == n && (EAGAIN == errno || EINTR == errno)) return;
+  if (n <= 0) {
+    conn_close(conn);
+    return;
+  }
+
+  conn->inlen += n;
+  conn->in[conn->inlen] = '\0';
+
+  char *nl = strchr(conn->in, '\n');
+  if (!nl && conn->inlen < sizeof(conn->in) - 1) return;
+  if (nl) *nl = '\0';
+
+  dispatch(conn, conn->in);
+  if (!conn->out.len) buffer_printf(&conn->out, "\n");
+  conn_write(conn);
+}
+
+/*
+ * Accept connections.
+ */
+
+static void
+on_accept(loop_io_t *io, uint32_t events) {
+  int fd;
+
+  while (-1 != (fd = accept4(io->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC))) {
+    conn_t *conn = calloc(1, sizeof(conn_t));
+    if (!conn) {
+      close(fd);
+      return;
+    }
+    loop_add(&conn->io, fd, EPOLLIN, on_conn, conn);
+  }
+}
+
+/*
+ * Fill `addr` for `path`, returning -1 when too long.
+ */
+
+static int
+socket_addr(struct sockaddr_un *addr, const char *path) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr->sun_path)) return -1;
+  strcpy(addr->sun_path, path);
+  return 0;
+}
+
+/*
+ * Listen for control requests on the unix socket at `path`.
+ */
+
+void
+control_listen(const char *path) {
+  struct sockaddr_un addr;
+
+  if (-1 == socket_addr(&addr, path)) error("--control path too long");
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (-1 == fd) {
+    perror("socket()");
+    exit(1);
+  }
+
+  unlink(path);
+  if (-1 == bind(fd, (struct sockaddr *) &addr, sizeof(addr)) || -1 == listen(fd, 128)) {
+    perror("bind()");
+    exit(1);
+  }
+
+  socket_path = path;
+  loop_add(&listener, fd, EPOLLIN, on_accept, NULL);
+  log("control socket %s", path);
+}
+
+/*
+ * Remove the control socket.
+ */
+
+void
+control_close() {
+  if (!socket_path) return;
+  close(listener.fd);
+  unlink(socket_path);
+}
@@ -0,0 +1,41 @@
+//
+// control.h
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stddef.h>
+
+/*
+ * Max request line length.
+ */
+
+#ifndef CONTROL_MAX_REQUEST
+#define CONTROL_MAX_REQUEST 256
+#endif
+
+/*
+ * Growable response buffer.
+ */
+
+typedef struct {
+  char *data;
+  size_t len;
+  size_t cap;
+} buffer_t;
+
+// prototypes
+
+void
+buffer_printf(buffer_t *buf, const char *fmt, ...);
+
+void
+control_listen(const char *path);
+
+void
+control_close();
+
+#endif /* CONTROL_H */
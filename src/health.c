@@ -0,0 +1,341 @@
+//
+// health.c
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/uio.h>
+#include "health.h"
+#include "hook.h"
+#include "listen.h"
+#include "mon.h"
+
+/*
+ * Parse `probe` into `health`, exiting on error:
+ *
+ *   tcp:<host>:<port> [request]
+ *   unix:<path> [request]
+ *   <cmd>
+ *
+ * Socket probes pass once connected, or when given
+ * a request line once any response is read.
+ */
+
+void
+health_parse(health_t *health, const char *flag, const char *probe) {
+  health->probe = probe;
+  health->request = NULL;
+  health->type = HEALTH_CMD;
+
+  if (strncmp(probe, "tcp:", 4) && strncmp(probe, "unix:", 5)) return;
+
+  char addr[512];
+  size_t len = strcspn(probe, " ");
+  if (len >= sizeof(addr)) error("invalid %s `%s`", flag, probe);
+  memcpy(addr, probe, len);
+  addr[len] = '\0';
+  if (probe[len]) health->request = probe + len + 1;
+
+  int family = listen_resolve(flag, addr, &health->addr, &health->addrlen, 0);
+  health->type = AF_UNIX == family ? HEALTH_UNIX : HEALTH_TCP;
+}
+
+/*
+ * Close the socket of a probe.
+ */
+
+static void
+close_socket(health_t *health) {
+  if (-1 == health->io.fd) return;
+  loop_remove(&health->io);
+  close(health->io.fd);
+  health->io.fd = -1;
+}
+
+/*
+ * Complete a probe. A passing --ready probe marks
+ * its child ready, while --health probes restart
+ * the child past --health-failures failures.
+ */
+
+static void
+done(health_t *health, bool ok, const char *reason) {
+  monitor_t *monitor = health->monitor;
+
+  health->running = false;
+  loop_timer_stop(&health->deadline);
+  close_socket(health);
+
+  if (health == &monitor->ready) {
+    if (!ok || monitor->ready_at) return;
+    ready(monitor);
+    return;
+  }
+
+  if (ok) {
+    if (health->failures) mlog(monitor, "health check passed");
+    health->failures = 0;
+    return;
+  }
+
+  health->failures++;
+  monitor->metrics.health_failures++;
+  mlog(monitor, "health check failed: %s (%d/%d)", reason, health->failures, health->max_failures);
+  if (health->failures < health->max_failures) return;
+
+  mlog(monitor, "unhealthy, restarting");
+  hook_emit(monitor, "unhealthy", ",\"pid\":%d,\"failures\":%d", monitor->pid, health->failures);
+  health->failures = 0;
+  terminate(monitor);
+}
+
+/*
+ * Probe socket ready.
+ */
+
+static void
+on_socket(loop_io_t *io, uint32_t events) {
+  health_t *health = io->data;
+  char buf[512];
+
+  // response
+  if (health->request && (events & EPOLLIN)) {
+    ssize_t n = read(io->fd, buf, sizeof(buf));
+    if (n > 0) done(health, true, NULL);
+    else if (0 == n) done(health, false, "connection closed");
+    else if (EAGAIN != errno) done(health, false, strerror(errno));
+    return;
+  }
+
+  // connected
+  int err = 0;
+  socklen_t len = sizeof(err);
+  getsockopt(io->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+  if (err) {
+    done(health, false, strerror(err));
+    return;
+  }
+
+  if (!health->request) {
+    done(health, true, NULL);
+    return;
+  }
+
+  struct iovec iov[2] = {
+    { (char *) health->request, strlen(health->request) },
+    { "\n", 1 }
+  };
+
+  if (iov[0].iov_len + 1 != writev(io->fd, iov, 2)) {
+    done(health, false, "request failed");
+    return;
+  }
+
+  loop_modify(io, EPOLLIN);
+}
+
+/*
+ * Connect the socket of `health`.
+ */
+
+static void
+probe_socket(health_t *health) {
+  int family = HEALTH_UNIX == health->type ? AF_UNIX : health->addr.ss_family;
+
+  int fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (-1 == fd) {
+    done(health, false, strerror(errno));
+    return;
+  }
+
+  loop_add(&health->io, fd, EPOLLOUT, on_socket, health);
+  if (-1 == connect(fd, (struct sockaddr *) &health->addr, health->addrlen)
+    && EINPROGRESS != errno
+    && EAGAIN != errno) {
+    done(health, false, strerror(errno));
+  }
+}
+
+/*
+ * Spawn the command of `health`.
+ */
+
+static void
+probe_cmd(health_t *health) {
+  int err = hook_spawn(&health->pid, health->probe, -1);
+  if (err) {
+    health->pid = 0;
+    done(health, false, strerror(err));
+  }
+}
+
+/*
+ * Probe interval elapsed, skipped while the
+ * last probe command is yet to be reaped.
+ */
+
+static void
+on_interval(loop_timer_t *timer) {
+  health_t *health = timer->data;
+
+  if (health->running || health->pid || health->monitor->stopping) return;
+
+  health->running = true;
+  loop_timer_start(&health->deadline, health->timeout, 0);
+
+  if (HEALTH_CMD == health->type) probe_cmd(health);
+  else probe_socket(health);
+}
+
+/*
+ * Probe timed out.
+ */
+
+static void
+on_deadline(loop_timer_t *timer) {
+  health_t *health = timer->data;
+  if (health->pid) kill(-health->pid, SIGKILL);
+  done(health, false, "timed out");
+}
+
+/*
+ * Initialize the timers of `health`.
+ */
+
+static void
+init(monitor_t *monitor, health_t *health) {
+  health->monitor = monitor;
+  health->io.fd = -1;
+  health->pid = 0;
+  health->running = false;
+  loop_timer_init(&health->timer, on_interval, health);
+  loop_timer_init(&health->deadline, on_deadline, health);
+}
+
+/*
+ * Initialize the probes of `monitor`.
+ */
+
+void
+health_init(monitor_t *monitor) {
+  if (monitor->health.probe) init(monitor, &monitor->health);
+  if (monitor->ready.probe) {
+    monitor->ready.timeout = monitor->health.timeout;
+    init(monitor, &monitor->ready);
+  }
+}
+
+/*
+ * Probe the child of `monitor` every --health-interval,
+ * starting one interval after it is ready.
+ */
+
+void
+health_watch(monitor_t *monitor) {
+  health_t *health = &monitor->health;
+  if (!health->probe) return;
+  health->failures = 0;
+  loop_timer_start(&health->timer, health->interval, health->interval);
+}
+
+/*
+ * Probe the freshly spawned child of `monitor` every
+ * HEALTH_READY_INTERVAL until --ready passes.
+ */
+
+void
+health_ready(monitor_t *monitor) {
+  health_t *health = &monitor->ready;
+  if (!health->probe) return;
+  loop_timer_start(&health->timer, HEALTH_READY_INTERVAL, HEALTH_READY_INTERVAL);
+}
+
+/*
+ * Abandon the probe of `health` in flight.
+ */
+
+static void
+cancel(health_t *health) {
+  if (!health->probe) return;
+  loop_timer_stop(&health->timer);
+  loop_timer_stop(&health->deadline);
+  if (health->pid) kill(-health->pid, SIGKILL);
+  health->running = false;
+  close_socket(health);
+}
+
+/*
+ * Stop probing the child of `monitor`.
+ */
+
+void
+health_unwatch(monitor_t *monitor) {
+  cancel(&monitor->health);
+  cancel(&monitor->ready);
+}
+
+/*
+ * Close the probe timers of `monitor`.
+ */
+
+void
+health_close(monitor_t *monitor) {
+  health_unwatch(monitor);
+  if (monitor->health.probe) {
+    loop_timer_close(&monitor->health.timer);
+    loop_timer_close(&monitor->health.deadline);
+  }
+  if (monitor->ready.probe) {
+    loop_timer_close(&monitor->ready.timer);
+    loop_timer_close(&monitor->ready.deadline);
+  }
+}
+
+/*
+ * Handle exit `status` of the probe command of `health`.
+ */
+
+static void
+reaped(health_t *health, int status) {
+  health->pid = 0;
+  if (!health->running) return;
+
+  if (WIFEXITED(status) && 0 == WEXITSTATUS(status)) {
+    done(health, true, NULL);
+  } else {
+    char reason[64];
+    if (WIFSIGNALED(status)) snprintf(reason, sizeof(reason), "signal %d", WTERMSIG(status));
+    else snprintf(reason, sizeof(reason), "exit %d", WEXITSTATUS(status));
+    done(health, false, reason);
+  }
+}
+
+/*
+ * Handle exit `status` of a probe command, returning
+ * 1 when `pid` was one.
+ */
+
+int
+health_reap(pid_t pid, int status) {
+  for (monitor_t *m = monitors; m; m = m->next) {
+    if (m->health.probe && pid == m->health.pid) {
+      reaped(&m->health, status);
+      return 1;
+    }
+
+    if (m->ready.probe && pid == m->ready.pid) {
+      reaped(&m->ready, status);
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,80 @@
+//
+// health.h
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#ifndef HEALTH_H
+#define HEALTH_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include "loop.h"
+
+/*
+ * Interval --ready probes are retried at in ms.
+ */
+
+#ifndef HEALTH_READY_INTERVAL
+#define HEALTH_READY_INTERVAL 250
+#endif
+
+/*
+ * Probe types.
+ */
+
+enum {
+  HEALTH_CMD,
+  HEALTH_TCP,
+  HEALTH_UNIX
+};
+
+/*
+ * Liveness or readiness probe of a monitor.
+ */
+
+struct monitor;
+
+typedef struct {
+  struct monitor *monitor;
+  const char *probe;
+  int type;
+  struct sockaddr_storage addr;
+  socklen_t addrlen;
+  const char *request;
+  int64_t interval;
+  int64_t timeout;
+  int max_failures;
+  int failures;
+  bool running;
+  pid_t pid;
+  loop_io_t io;
+  loop_timer_t timer;
+  loop_timer_t deadline;
+} health_t;
+
+// prototypes
+
+void
+health_parse(health_t *health, const char *flag, const char *probe);
+
+void
+health_init(struct monitor *monitor);
+
+void
+health_close(struct monitor *monitor);
+
+void
+health_watch(struct monitor *monitor);
+
+void
+health_ready(struct monitor *monitor);
+
+void
+health_unwatch(struct monitor *monitor);
+
+int
+health_reap(pid_t pid, int status);
+
+#endif /* HEALTH_H */
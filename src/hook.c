@@ -0,0 +1,426 @@
+//
+// hook.c
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include "hook.h"
+#include "ms.h"
+
+/*
+ * Hook invocation.
+ */
+
+typedef struct hook {
+  monitor_t *monitor;
+  const char *name;
+  char cmd[1024];
+  pid_t pid;
+  int64_t started_at;
+  loop_timer_t timer;
+  struct hook *next;
+} hook_t;
+
+/*
+ * Running hooks.
+ */
+
+static hook_t *running = NULL;
+static int nrunning = 0;
+
+/*
+ * Hooks waiting for a free slot, oldest first.
+ */
+
+static hook_t *queue = NULL;
+static int nqueued = 0;
+
+/*
+ * Finished hooks, reused rather than freed.
+ */
+
+static hook_t *spare = NULL;
+
+/*
+ * Max concurrent hooks.
+ */
+
+static int max_running = 8;
+
+/*
+ * Persistent --events process.
+ */
+
+static const char *events_cmd = NULL;
+static pid_t events_pid = 0;
+static loop_io_t events_io;
+
+/*
+ * Events not yet written to the --events process.
+ */
+
+static char events_buf[HOOK_EVENTS_BUFFER];
+static size_t events_len = 0;
+
+/*
+ * The buffer starts with the rest of a line
+ * partly written to the --events process.
+ */
+
+static int events_partial = 0;
+
+extern char **environ;
+
+/*
+ * Set the max concurrent hooks.
+ */
+
+void
+hook_limit(int max) {
+  max_running = max;
+}
+
+/*
+ * Hook exceeded its --hook-timeout, kill its process group.
+ */
+
+static void
+on_timeout(loop_timer_t *timer) {
+  hook_t *hook = timer->data;
+  char str[MS_LEN];
+  milliseconds_to_string_r(hook->monitor->hook_timeout, str, sizeof(str));
+  mlog(hook->monitor, "%s `%s` timed out after %s, killing", hook->name, hook->cmd, str);
+  kill(-hook->pid, SIGKILL);
+}
+
+/*
+ * Spawn `cmd` through sh -c in its own process group,
+ * with signals unblocked and reset, and `fd` as stdin
+ * when not -1.
+ */
+
+int
+hook_spawn(pid_t *pid, const char *cmd, int fd) {
+  posix_spawnattr_t attr;
+  posix_spawn_file_actions_t actions;
+  sigset_t mask, def;
+  char *argv[] = { "sh", "-c", (char *) cmd, NULL };
+
+  sigemptyset(&mask);
+  sigemptyset(&def);
+  sigaddset(&def, SIGTERM);
+  sigaddset(&def, SIGQUIT);
+  sigaddset(&def, SIGPIPE);
+
+  posix_spawnattr_init(&attr);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK
+    | POSIX_SPAWN_SETSIGDEF
+    | POSIX_SPAWN_SETPGROUP);
+  posix_spawnattr_setsigmask(&attr, &mask);
+  posix_spawnattr_setsigdefault(&attr, &def);
+  posix_spawnattr_setpgroup(&attr, 0);
+
+  posix_spawn_file_actions_init(&actions);
+  if (-1 != fd) posix_spawn_file_actions_adddup2(&actions, fd, 0);
+
+  int err = posix_spawn(pid, "/bin/sh", &actions, &attr, argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attr);
+  return err;
+}
+
+/*
+ * Release `hook` for reuse.
+ */
+
+static void
+release(hook_t *hook) {
+  hook->next = spare;
+  spare = hook;
+}
+
+/*
+ * Spawn `hook`.
+ */
+
+static void
+spawn(hook_t *hook) {
+  mlog(hook->monitor, "%s `%s`", hook->name, hook->cmd);
+  int err = hook_spawn(&hook->pid, hook->cmd, -1);
+
+  if (err) {
+    mlog(hook->monitor, "%s failed: %s", hook->name, strerror(err));
+    release(hook);
+    return;
+  }
+
+  hook->started_at = timestamp();
+  hook->next = running;
+  running = hook;
+  nrunning++;
+
+  loop_timer_init(&hook->timer, on_timeout, hook);
+  if (hook->monitor->hook_timeout) {
+    loop_timer_start(&hook->timer, hook->monitor->hook_timeout, 0);
+  }
+}
+
+/*
+ * Run `cmd` with `pid` appended for `monitor` without
+ * waiting for it. Past --max-hooks running hooks
+ * the invocation is queued.
+ */
+
+void
+hook_exec(monitor_t *monitor, const char *name, const char *cmd, pid_t pid) {
+  hook_t *hook = spare;
+  if (hook) spare = hook->next;
+  else if (!(hook = calloc(1, sizeof(hook_t)))) error("out of memory");
+  hook->monitor = monitor;
+  hook->name = name;
+  hook->next = NULL;
+  snprintf(hook->cmd, sizeof(hook->cmd), "%s %d", cmd, pid);
+
+  if (nrunning < max_running) {
+    spawn(hook);
+    return;
+  }
+
+  if (nqueued == HOOK_MAX_PENDING) {
+    mlog(monitor, "%d hooks pending, dropping %s `%s`", nqueued, name, hook->cmd);
+    release(hook);
+    return;
+  }
+
+  hook_t **tail = &queue;
+  while (*tail) tail = &(*tail)->next;
+  *tail = hook;
+  nqueued++;
+}
+
+/*
+ * Handle exit `status` of `pid` when it is a hook,
+ * returning 1, or 0 otherwise.
+ */
+
+int
+hook_reap(pid_t pid, int status) {
+  if (events_pid && pid == events_pid) {
+    if (WIFSIGNALED(status)) log("events signal(%s)", strsignal(WTERMSIG(status)));
+    else log("events exit(%d)", WEXITSTATUS(status));
+    loop_remove(&events_io);
+    close(events_io.fd);
+    events_pid = 0;
+
+    // the next process starts at a whole line
+    char *nl = events_partial ? memchr(events_buf, '\n', events_len) : NULL;
+    if (nl) {
+      size_t skip = nl + 1 - events_buf;
+      memmove(events_buf, nl + 1, events_len - skip);
+      events_len -= skip;
+    }
+    events_partial = 0;
+    return 1;
+  }
+
+  hook_t **ptr = &running;
+  while (*ptr && (*ptr)->pid != pid) ptr = &(*ptr)->next;
+  if (!*ptr) return 0;
+
+  hook_t *hook = *ptr;
+  *ptr = hook->next;
+  nrunning--;
+
+  metrics_t *metrics = &hook->monitor->metrics;
+  int64_t duration = timestamp() - hook->started_at;
+  if (!strcmp("on error", hook->name)) histogram_observe(&metrics->error_hook, duration);
+  else histogram_observe(&metrics->restart_hook, duration);
+
+  if (WIFSIGNALED(status)) {
+    mlog(hook->monitor, "%s signal(%s)", hook->name, strsignal(WTERMSIG(status)));
+  } else if (WEXITSTATUS(status)) {
+    mlog(hook->monitor, "%s exit(%d)", hook->name, WEXITSTATUS(status));
+  }
+
+  loop_timer_close(&hook->timer);
+  release(hook);
+
+  // next queued
+  while (queue && nrunning < max_running) {
+    hook_t *next = queue;
+    queue = next->next;
+    nqueued--;
+    spawn(next);
+  }
+
+  return 1;
+}
+
+/*
+ * Return the number of running and queued hooks.
+ */
+
+int
+hook_pending() {
+  return nrunning + nqueued;
+}
+
+/*
+ * Return the number of running and queued hooks
+ * of `monitor`.
+ */
+
+int
+hook_refs(monitor_t *monitor) {
+  int n = 0;
+  for (hook_t *hook = running; hook; hook = hook->next) n += hook->monitor == monitor;
+  for (hook_t *hook = queue; hook; hook = hook->next) n += hook->monitor == monitor;
+  return n;
+}
+
+/*
+ * Flush buffered events, returning -1 when the
+ * --events process went away.
+ */
+
+static int
+events_flush() {
+  size_t off = 0;
+
+  while (off < events_len) {
+    ssize_t n = write(events_io.fd, events_buf + off, events_len - off);
+    if (-1 == n) {
+      if (EINTR == errno) continue;
+      if (EAGAIN == errno) break;
+      events_len = 0;
+      events_partial = 0;
+      return -1;
+    }
+    off += n;
+  }
+
+  if (off) events_partial = '\n' != events_buf[off - 1];
+  memmove(events_buf, events_buf + off, events_len - off);
+  events_len -= off;
+  return 0;
+}
+
+/*
+ * --events process stdin writable.
+ */
+
+static void
+on_events_writable(loop_io_t *io, uint32_t events) {
+  if (-1 == events_flush() || !events_len) loop_modify(io, 0);
+}
+
+/*
+ * Start the --events process.
+ */
+
+static void
+events_start() {
+  int fds[2];
+
+  if (-1 == pipe2(fds, O_CLOEXEC)) {
+    perror("pipe2()");
+    return;
+  }
+
+  int err = hook_spawn(&events_pid, events_cmd, fds[0]);
+  close(fds[0]);
+
+  if (err) {
+    log("events `%s` failed: %s", events_cmd, strerror(err));
+    close(fds[1]);
+    events_pid = 0;
+    return;
+  }
+
+  log("events `%s` %d", events_cmd, events_pid);
+  fcntl(fds[1], F_SETFL, O_NONBLOCK);
+  loop_add(&events_io, fds[1], events_len ? EPOLLOUT : 0, on_events_writable, NULL);
+}
+
+/*
+ * Stream events to the stdin of a persistent `cmd`.
+ */
+
+void
+hook_events(const char *cmd) {
+  events_cmd = cmd;
+}
+
+/*
+ * Write a newline-delimited JSON `event` of `monitor` to the
+ * --events process, `fmt` providing any additional fields.
+ * The process is (re)started when necessary, and events
+ * are buffered while its stdin is full.
+ */
+
+void
+hook_emit(monitor_t *monitor, const char *event, const char *fmt, ...) {
+  char line[1024];
+  char service[256];
+  va_list args;
+
+  if (!events_cmd) return;
+  if (!events_pid) events_start();
+  if (!events_pid) return;
+
+  const char *name = monitor_prefix(monitor);
+  json_escape(service, sizeof(service), name ? name : monitor->cmd);
+
+  int n = snprintf(line, sizeof(line), "{\"event\":\"%s\",\"service\":\"%s\"", event, service);
+  va_start(args, fmt);
+  n += vsnprintf(line + n, sizeof(line) - n, fmt, args);
+  va_end(args);
+  if (n > sizeof(line) - 3) n = sizeof(line) - 3;
+  n += snprintf(line + n, sizeof(line) - n, "}\n");
+
+  if (events_len + n > sizeof(events_buf)) {
+    log("events buffer full, dropping %s event", event);
+    return;
+  }
+
+  int pending = events_len > 0;
+  memcpy(events_buf + events_len, line, n);
+  events_len += n;
+  if (pending) return;
+
+  if (-1 == events_flush()) return;
+  if (events_len) loop_modify(&events_io, EPOLLOUT);
+}
+
+/*
+ * Flush remaining events for up to HOOK_EVENTS_TIMEOUT,
+ * so that a stalled process can't hold up mon's exit,
+ * and close the stdin of the --events process so it
+ * may exit.
+ */
+
+void
+hook_close() {
+  if (!events_pid) return;
+  struct pollfd pfd = { .fd = events_io.fd, .events = POLLOUT };
+  int64_t deadline = timestamp() + HOOK_EVENTS_TIMEOUT;
+
+  while (events_len && -1 != events_flush() && events_len) {
+    int64_t ms = deadline - timestamp();
+    if (ms <= 0 || poll(&pfd, 1, ms) <= 0) break;
+  }
+
+  if (events_len) log("events stalled, dropping %zu bytes", events_len);
+  close(events_io.fd);
+}
@@ -0,0 +1,65 @@
+//
+// hook.h
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#ifndef HOOK_H
+#define HOOK_H
+
+#include "mon.h"
+
+/*
+ * Max hooks queued while --max-hooks are running.
+ */
+
+#ifndef HOOK_MAX_PENDING
+#define HOOK_MAX_PENDING 64
+#endif
+
+/*
+ * Bytes of events buffered for the --events process.
+ */
+
+#ifndef HOOK_EVENTS_BUFFER
+#define HOOK_EVENTS_BUFFER 65536
+#endif
+
+/*
+ * Milliseconds events are flushed for on exit.
+ */
+
+#ifndef HOOK_EVENTS_TIMEOUT
+#define HOOK_EVENTS_TIMEOUT 1000
+#endif
+
+// prototypes
+
+void
+hook_limit(int max);
+
+int
+hook_spawn(pid_t *pid, const char *cmd, int fd);
+
+void
+hook_exec(monitor_t *monitor, const char *name, const char *cmd, pid_t pid);
+
+int
+hook_reap(pid_t pid, int status);
+
+int
+hook_pending();
+
+int
+hook_refs(monitor_t *monitor);
+
+void
+hook_events(const char *cmd);
+
+void
+hook_emit(monitor_t *monitor, const char *event, const char *fmt, ...);
+
+void
+hook_close();
+
+#endif /* HOOK_H */
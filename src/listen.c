@@ -0,0 +1,214 @@
+//
+// listen.c
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/un.h>
+#include "listen.h"
+#include "mon.h"
+
+/*
+ * Resolve `str` of `flag`, tcp:<host>:<port> or unix:<path>,
+ * into `addr`, returning its family or -1 when `str` is
+ * neither. An empty host is the wildcard address when
+ * `passive` and localhost otherwise. Exits on error.
+ */
+
+int
+listen_resolve(const char *flag, const char *str, struct sockaddr_storage *addr, socklen_t *len, int passive) {
+  if (strncmp(str, "tcp:", 4) && strncmp(str, "unix:", 5)) return -1;
+
+  memset(addr, 0, sizeof(*addr));
+
+  // unix
+  if ('u' == str[0]) {
+    struct sockaddr_un *un = (struct sockaddr_un *) addr;
+    const char *path = str + 5;
+    if (!*path || strlen(path) >= sizeof(un->sun_path)) goto invalid;
+    un->sun_family = AF_UNIX;
+    strcpy(un->sun_path, path);
+    *len = sizeof(*un);
+    return AF_UNIX;
+  }
+
+  // tcp
+  char *host = strdup(str + 4);
+  if (!host) error("out of memory");
+  char *port = strrchr(host, ':');
+  if (!port) {
+    free(host);
+    goto invalid;
+  }
+  *port++ = '\0';
+
+  struct addrinfo hints, *res;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if (passive) hints.ai_flags = AI_PASSIVE;
+
+  const char *node = *host ? host : passive ? NULL : "localhost";
+  int err = getaddrinfo(node, port, &hints, &res);
+  free(host);
+  if (err) {
+    error("%s `%s`: %s", flag, str, gai_strerror(err));
+  }
+
+  memcpy(addr, res->ai_addr, res->ai_addrlen);
+  *len = res->ai_addrlen;
+  int family = res->ai_family;
+  freeaddrinfo(res);
+  return family;
+
+invalid:
+  error("invalid %s `%s`", flag, str);
+}
+
+/*
+ * Add listening socket `str` to `monitor`.
+ */
+
+void
+listen_add(monitor_t *monitor, const char *str) {
+  struct sockaddr_storage addr;
+  socklen_t len;
+
+  if (-1 == listen_resolve("--listen", str, &addr, &len, 1)) {
+    error("invalid --listen `%s`", str);
+  }
+
+  if (LISTEN_MAX == monitor->nlisten) error("too many --listen sockets");
+  monitor->listen[monitor->nlisten++] = str;
+}
+
+/*
+ * Bind and listen on `str`, returning the fd
+ * or -1 on error.
+ */
+
+static int
+bind_socket(const char *str) {
+  struct sockaddr_storage addr;
+  socklen_t len;
+  int on = 1;
+
+  int family = listen_resolve("--listen", str, &addr, &len, 1);
+  int fd = socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (-1 == fd) {
+    perror("socket()");
+    exit(1);
+  }
+
+  if (AF_UNIX == family) {
+    unlink(((struct sockaddr_un *) &addr)->sun_path);
+  } else {
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  }
+
+  if (-1 == bind(fd, (struct sockaddr *) &addr, len) || -1 == listen(fd, SOMAXCONN)) {
+    log("--listen %s: %s", str, strerror(errno));
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+/*
+ * Bind the --listen sockets of `monitor`, returning -1
+ * on error. They stay open for the lifetime of the
+ * monitor, so that connections queue in the backlog
+ * while its child is restarted. Sockets handed over
+ * by the monitor it replaces are kept as they are.
+ */
+
+int
+listen_init(monitor_t *monitor) {
+  if (monitor->listening) return 0;
+
+  for (int i = 0; i < monitor->nlisten; ++i) {
+    monitor->listen_fds[i] = bind_socket(monitor->listen[i]);
+    if (-1 == monitor->listen_fds[i]) {
+      while (i--) close(monitor->listen_fds[i]);
+      return -1;
+    }
+    mlog(monitor, "listening on %s", monitor->listen[i]);
+  }
+
+  monitor->listening = true;
+  return 0;
+}
+
+/*
+ * Close the --listen sockets of `monitor`.
+ */
+
+void
+listen_close(monitor_t *monitor) {
+  if (!monitor->listening) return;
+
+  for (int i = 0; i < monitor->nlisten; ++i) {
+    close(monitor->listen_fds[i]);
+  }
+
+  monitor->listening = false;
+}
+
+/*
+ * Hand the --listen sockets of `monitor` over to
+ * `replacement` when it listens on the same addresses,
+ * so that connections keep queueing rather than being
+ * refused while a changed service restarts. Otherwise
+ * they are closed.
+ */
+
+void
+listen_handover(monitor_t *monitor, monitor_t *replacement) {
+  if (!monitor->nlisten && !replacement->nlisten) return;
+
+  bool same = monitor->listening && monitor->nlisten == replacement->nlisten;
+
+  for (int i = 0; same && i < monitor->nlisten; ++i) {
+    same = !strcmp(monitor->listen[i], replacement->listen[i]);
+  }
+
+  if (!same) {
+    listen_close(monitor);
+    return;
+  }
+
+  memcpy(replacement->listen_fds, monitor->listen_fds, sizeof(monitor->listen_fds));
+  replacement->listening = true;
+  monitor->listening = false;
+  mlog(replacement, "taking over the --listen sockets");
+}
+
+/*
+ * Pass the sockets of `monitor` to the calling child
+ * as fds LISTEN_FDS_START and up. The child shares
+ * mon's memory until it execs, so only fds are touched
+ * here, LISTEN_FDS and LISTEN_PID are set by spawn_child().
+ */
+
+void
+listen_pass(monitor_t *monitor) {
+  int n = monitor->nlisten;
+  int fds[LISTEN_MAX];
+
+  // move out of the way of the target fds first
+  for (int i = 0; i < n; ++i) {
+    fds[i] = fcntl(monitor->listen_fds[i], F_DUPFD_CLOEXEC, LISTEN_FDS_START + n);
+  }
+
+  for (int i = 0; i < n; ++i) {
+    dup2(fds[i], LISTEN_FDS_START + i);
+  }
+}
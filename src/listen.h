@@ -0,0 +1,48 @@
+//
+// listen.h
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#ifndef LISTEN_H
+#define LISTEN_H
+
+#include <sys/socket.h>
+
+/*
+ * Max --listen sockets per monitor.
+ */
+
+#ifndef LISTEN_MAX
+#define LISTEN_MAX 8
+#endif
+
+/*
+ * First fd passed to children, as with systemd.
+ */
+
+#define LISTEN_FDS_START 3
+
+// prototypes
+
+struct monitor;
+
+int
+listen_resolve(const char *flag, const char *str, struct sockaddr_storage *addr, socklen_t *len, int passive);
+
+void
+listen_add(struct monitor *monitor, const char *str);
+
+int
+listen_init(struct monitor *monitor);
+
+void
+listen_close(struct monitor *monitor);
+
+void
+listen_handover(struct monitor *monitor, struct monitor *replacement);
+
+void
+listen_pass(struct monitor *monitor);
+
+#endif /* LISTEN_H */
@@ -0,0 +1,329 @@
+//
+// loop.c
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include "loop.h"
+
+/*
+ * Max events dispatched per epoll_wait().
+ */
+
+#define LOOP_MAX_EVENTS 64
+
+/*
+ * Epoll instance.
+ */
+
+static int epfd = -1;
+
+/*
+ * Running flag.
+ */
+
+static int running = 0;
+
+/*
+ * Prepare callbacks.
+ */
+
+static loop_prepare_cb_t prepare[LOOP_MAX_PREPARE];
+static int nprepare = 0;
+
+/*
+ * Armed timers, a min-heap on their deadline
+ * bounding each wait for events.
+ */
+
+static loop_timer_t **heap = NULL;
+static int nheap = 0;
+static int heapcap = 0;
+
+/*
+ * Return monotonic time in nanoseconds.
+ */
+
+static int64_t
+now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * Place `timer` at `i` in the heap.
+ */
+
+static void
+place(loop_timer_t *timer, int i) {
+  heap[i] = timer;
+  timer->slot = i + 1;
+}
+
+/*
+ * Move the timer at `i` up to its place.
+ */
+
+static void
+sift_up(int i) {
+  loop_timer_t *timer = heap[i];
+
+  while (i) {
+    int parent = (i - 1) / 2;
+    if (heap[parent]->at <= timer->at) break;
+    place(heap[parent], i);
+    i = parent;
+  }
+
+  place(timer, i);
+}
+
+/*
+ * Move the timer at `i` down to its place.
+ */
+
+static void
+sift_down(int i) {
+  loop_timer_t *timer = heap[i];
+
+  for (;;) {
+    int child = 2 * i + 1;
+    if (child >= nheap) break;
+    if (child + 1 < nheap && heap[child + 1]->at < heap[child]->at) child++;
+    if (timer->at <= heap[child]->at) break;
+    place(heap[child], i);
+    i = child;
+  }
+
+  place(timer, i);
+}
+
+/*
+ * Add `timer` to the heap.
+ */
+
+static void
+heap_push(loop_timer_t *timer) {
+  if (nheap == heapcap) {
+    heapcap = heapcap ? heapcap * 2 : 64;
+    heap = realloc(heap, heapcap * sizeof(loop_timer_t *));
+    if (!heap) {
+      perror("realloc()");
+      exit(1);
+    }
+  }
+
+  place(timer, nheap++);
+  sift_up(timer->slot - 1);
+}
+
+/*
+ * Remove `timer` from the heap.
+ */
+
+static void
+heap_remove(loop_timer_t *timer) {
+  int i = timer->slot - 1;
+  loop_timer_t *last = heap[--nheap];
+  timer->slot = 0;
+  if (i == nheap) return;
+
+  place(last, i);
+  sift_up(i);
+  sift_down(last->slot - 1);
+}
+
+/*
+ * Return the ms until the earliest timer is due,
+ * rounded up, or -1 when none is armed.
+ */
+
+static int
+next_timeout() {
+  if (!nheap) return -1;
+  int64_t ns = heap[0]->at - now();
+  if (ns <= 0) return 0;
+  int64_t ms = (ns + 999999) / 1000000;
+  return ms > INT_MAX ? INT_MAX : ms;
+}
+
+/*
+ * Invoke the timers that are due, re-arming repeating
+ * ones. Missed repeats coalesce into one call.
+ */
+
+static void
+run_timers() {
+  int64_t t = now();
+
+  while (running && nheap && heap[0]->at <= t) {
+    loop_timer_t *timer = heap[0];
+
+    if (timer->repeat) {
+      timer->at += timer->repeat * 1000000;
+      if (timer->at <= t) timer->at = t + timer->repeat * 1000000;
+      sift_down(0);
+    } else {
+      heap_remove(timer);
+    }
+
+    timer->cb(timer);
+  }
+}
+
+/*
+ * Create the epoll instance.
+ */
+
+void
+loop_init() {
+  epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (-1 == epfd) {
+    perror("epoll_create1()");
+    exit(1);
+  }
+}
+
+/*
+ * Dispatch events until loop_stop() is called.
+ */
+
+void
+loop_run() {
+  struct epoll_event events[LOOP_MAX_EVENTS];
+  running = 1;
+
+  while (running) {
+    for (int i = 0; i < nprepare; ++i) prepare[i]();
+    int n = epoll_wait(epfd, events, LOOP_MAX_EVENTS, next_timeout());
+
+    if (-1 == n) {
+      if (EINTR == errno) continue;
+      perror("epoll_wait()");
+      exit(1);
+    }
+
+    for (int i = 0; i < n && running; ++i) {
+      loop_io_t *io = events[i].data.ptr;
+      io->cb(io, events[i].events);
+    }
+
+    run_timers();
+  }
+}
+
+/*
+ * Stop the loop after the current dispatch.
+ */
+
+void
+loop_stop() {
+  running = 0;
+}
+
+/*
+ * Invoke `cb` before each wait for events, for
+ * example to flush output batched during dispatch.
+ */
+
+void
+loop_prepare(loop_prepare_cb_t cb) {
+  if (nprepare == LOOP_MAX_PREPARE) {
+    fprintf(stderr, "Error: maximum prepare callbacks exceeded\n");
+    exit(1);
+  }
+  prepare[nprepare++] = cb;
+}
+
+/*
+ * Watch `fd` for `events`, invoking `cb`.
+ */
+
+void
+loop_add(loop_io_t *io, int fd, uint32_t events, loop_io_cb_t cb, void *data) {
+  struct epoll_event ev = {0};
+  io->fd = fd;
+  io->cb = cb;
+  io->data = data;
+  ev.events = events;
+  ev.data.ptr = io;
+  if (-1 == epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev)) {
+    perror("epoll_ctl()");
+    exit(1);
+  }
+}
+
+/*
+ * Change the `events` watched by `io`.
+ */
+
+void
+loop_modify(loop_io_t *io, uint32_t events) {
+  struct epoll_event ev = {0};
+  ev.events = events;
+  ev.data.ptr = io;
+  if (-1 == epoll_ctl(epfd, EPOLL_CTL_MOD, io->fd, &ev)) {
+    perror("epoll_ctl()");
+    exit(1);
+  }
+}
+
+/*
+ * Stop watching `io`.
+ */
+
+void
+loop_remove(loop_io_t *io) {
+  epoll_ctl(epfd, EPOLL_CTL_DEL, io->fd, NULL);
+}
+
+/*
+ * Initialize `timer` invoking `cb`.
+ */
+
+void
+loop_timer_init(loop_timer_t *timer, loop_timer_cb_t cb, void *data) {
+  timer->cb = cb;
+  timer->data = data;
+  timer->at = 0;
+  timer->repeat = 0;
+  timer->slot = 0;
+}
+
+/*
+ * Fire `timer` in `ms`, then every `repeat` ms when non-zero.
+ */
+
+void
+loop_timer_start(loop_timer_t *timer, int64_t ms, int64_t repeat) {
+  if (timer->slot) heap_remove(timer);
+  timer->at = now() + ms * 1000000;
+  timer->repeat = repeat;
+  heap_push(timer);
+}
+
+/*
+ * Disarm `timer`.
+ */
+
+void
+loop_timer_stop(loop_timer_t *timer) {
+  if (timer->slot) heap_remove(timer);
+}
+
+/*
+ * Release `timer`.
+ */
+
+void
+loop_timer_close(loop_timer_t *timer) {
+  loop_timer_stop(timer);
+}
@@ -0,0 +1,103 @@
+//
+// loop.h
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#ifndef LOOP_H
+#define LOOP_H
+
+#include <stdint.h>
+#include <sys/epoll.h>
+
+/*
+ * I/O watcher.
+ */
+
+struct loop_io;
+
+/*
+ * I/O callback, invoked with the ready `events`.
+ */
+
+typedef void (* loop_io_cb_t)(struct loop_io *io, uint32_t events);
+
+typedef struct loop_io {
+  int fd;
+  loop_io_cb_t cb;
+  void *data;
+} loop_io_t;
+
+/*
+ * Timer, armed in the loop's heap of deadlines
+ * rather than with an fd of its own. Its `slot`
+ * in the heap is 1-based, so that a zeroed timer
+ * is a disarmed one.
+ */
+
+struct loop_timer;
+
+/*
+ * Timer callback.
+ */
+
+typedef void (* loop_timer_cb_t)(struct loop_timer *timer);
+
+typedef struct loop_timer {
+  loop_timer_cb_t cb;
+  void *data;
+  int64_t at;
+  int64_t repeat;
+  int slot;
+} loop_timer_t;
+
+/*
+ * Callback invoked before waiting for events.
+ */
+
+typedef void (* loop_prepare_cb_t)();
+
+/*
+ * Max prepare callbacks.
+ */
+
+#ifndef LOOP_MAX_PREPARE
+#define LOOP_MAX_PREPARE 8
+#endif
+
+// prototypes
+
+void
+loop_init();
+
+void
+loop_run();
+
+void
+loop_stop();
+
+void
+loop_prepare(loop_prepare_cb_t cb);
+
+void
+loop_add(loop_io_t *io, int fd, uint32_t events, loop_io_cb_t cb, void *data);
+
+void
+loop_modify(loop_io_t *io, uint32_t events);
+
+void
+loop_remove(loop_io_t *io);
+
+void
+loop_timer_init(loop_timer_t *timer, loop_timer_cb_t cb, void *data);
+
+void
+loop_timer_start(loop_timer_t *timer, int64_t ms, int64_t repeat);
+
+void
+loop_timer_stop(loop_timer_t *timer);
+
+void
+loop_timer_close(loop_timer_t *timer);
+
+#endif /* LOOP_H */
@@ -0,0 +1,263 @@
+//
+// metrics.c
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include "control.h"
+#include "metrics.h"
+#include "mon.h"
+
+/*
+ * Bucket upper bounds in ms, the last being +Inf.
+ */
+
+static const int64_t bounds[METRICS_BUCKETS - 1] = {
+  5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000
+};
+
+/*
+ * Textfile collector path.
+ */
+
+static const char *file_path = NULL;
+static loop_timer_t file_timer;
+
+/*
+ * Record `ms` in `h`.
+ */
+
+void
+histogram_observe(histogram_t *h, int64_t ms) {
+  int i = 0;
+  while (i < METRICS_BUCKETS - 1 && ms > bounds[i]) i++;
+  h->buckets[i]++;
+  h->count++;
+  h->sum += ms;
+}
+
+/*
+ * Escape `str` as a label value into `buf` of `len`.
+ */
+
+static void
+label_escape(char *buf, size_t len, const char *str) {
+  size_t i = 0;
+
+  for (; *str && i + 2 < len; ++str) {
+    switch (*str) {
+      case '"': buf[i++] = '\\'; buf[i++] = '"'; break;
+      case '\\': buf[i++] = '\\'; buf[i++] = '\\'; break;
+      case '\n': buf[i++] = '\\'; buf[i++] = 'n'; break;
+      default: buf[i++] = *str;
+    }
+  }
+
+  buf[i] = '\0';
+}
+
+/*
+ * Output metric family header.
+ */
+
+static void
+header(buffer_t *out, const char *name, const char *type, const char *help) {
+  buffer_printf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/*
+ * Output histogram `h` of metric `name` with `labels`.
+ */
+
+static void
+histogram(buffer_t *out, const char *name, const char *labels, histogram_t *h) {
+  uint64_t cumulative = 0;
+
+  for (int i = 0; i < METRICS_BUCKETS; ++i) {
+    cumulative += h->buckets[i];
+    if (i < METRICS_BUCKETS - 1) {
+      buffer_printf(out, "%s_bucket{%s,le=\"%g\"} %llu\n", name, labels
+        , bounds[i] / 1000.0, (unsigned long long) cumulative);
+    } else {
+      buffer_printf(out, "%s_bucket{%s,le=\"+Inf\"} %llu\n", name, labels
+        , (unsigned long long) cumulative);
+    }
+  }
+
+  buffer_printf(out, "%s_sum{%s} %g\n", name, labels, h->sum / 1000.0);
+  buffer_printf(out, "%s_count{%s} %llu\n", name, labels, (unsigned long long) h->count);
+}
+
+/*
+ * Write `labels` of `monitor` into `buf` of `len`.
+ */
+
+static void
+service_labels(monitor_t *monitor, char *buf, size_t len) {
+  char name[512];
+  const char *p = monitor_prefix(monitor);
+  label_escape(name, sizeof(name), p ? p : monitor->cmd);
+  snprintf(buf, len, "service=\"%s\"", name);
+}
+
+/*
+ * Render metrics of every monitor in the
+ * Prometheus text exposition format.
+ */
+
+void
+metrics_render(buffer_t *out) {
+  char labels[600];
+  char hook[700];
+  int64_t now = timestamp();
+
+  header(out, "mon_up", "gauge", "Whether the service is running.");
+  for (monitor_t *m = monitors; m; m = m->next) {
+    service_labels(m, labels, sizeof(labels));
+    buffer_printf(out, "mon_up{%s} %d\n", labels, m->pid ? 1 : 0);
+  }
+
+  header(out, "mon_uptime_seconds", "gauge", "Seconds since the service was started.");
+  for (monitor_t *m = monitors; m; m = m->next) {
+    service_labels(m, labels, sizeof(labels));
+    buffer_printf(out, "mon_uptime_seconds{%s} %g\n", labels
+      , m->pid ? (now - m->started_at) / 1000.0 : 0);
+  }
+
+  header(out, "mon_restarts_total", "counter", "Restarts performed.");
+  for (monitor_t *m = monitors; m; m = m->next) {
+    service_labels(m, labels, sizeof(labels));
+    buffer_printf(out, "mon_restarts_total{%s} %d\n", labels, m->restarts_total);
+  }
+
+  header(out, "mon_exits_total", "counter", "Exits by exit code or signal.");
+  for (monitor_t *m = monitors; m; m = m->next) {
+    service_labels(m, labels, sizeof(labels));
+    for (int i = 0; i < 256; ++i) {
+      if (!m->metrics.exit_codes[i]) continue;
+      buffer_printf(out, "mon_exits_total{%s,code=\"%d\"} %u\n", labels, i, m->metrics.exit_codes[i]);
+    }
+    for (int i = 0; i < NSIG; ++i) {
+      if (!m->metrics.signals[i]) continue;
+      buffer_printf(out, "mon_exits_total{%s,signal=\"%d\"} %u\n", labels, i, m->metrics.signals[i]);
+    }
+  }
+
+  header(out, "mon_cpu_seconds_total", "counter", "CPU seconds used by exited runs.");
+  for (monitor_t *m = monitors; m; m = m->next) {
+    service_labels(m, labels, sizeof(labels));
+    buffer_printf(out, "mon_cpu_seconds_total{%s,mode=\"user\"} %g\n", labels, m->totals.utime / 1e6);
+    buffer_printf(out, "mon_cpu_seconds_total{%s,mode=\"system\"} %g\n", labels, m->totals.stime / 1e6);
+  }
+
+  header(out, "mon_max_rss_bytes", "gauge", "Largest resident set size of exited runs.");
+  for (monitor_t *m = monitors; m; m = m->next) {
+    service_labels(m, labels, sizeof(labels));
+    buffer_printf(out, "mon_max_rss_bytes{%s} %lld\n", labels, (long long) m->totals.maxrss * 1024);
+  }
+
+  header(out, "mon_page_faults_total", "counter", "Page faults of exited runs.");
+  for (monitor_t *m = monitors; m; m = m->next) {
+    service_labels(m, labels, sizeof(labels));
+    buffer_printf(out, "mon_page_faults_total{%s,type=\"minor\"} %ld\n", labels, m->totals.minflt);
+    buffer_printf(out, "mon_page_faults_total{%s,type=\"major\"} %ld\n", labels, m->totals.majflt);
+  }
+
+  header(out, "mon_context_switches_total", "counter", "Context switches of exited runs.");
+  for (monitor_t *m = monitors; m; m = m->next) {
+    service_labels(m, labels, sizeof(labels));
+    buffer_printf(out, "mon_context_switches_total{%s,type=\"voluntary\"} %ld\n", labels, m->totals.nvcsw);
+    buffer_printf(out, "mon_context_switches_total{%s,type=\"involuntary\"} %ld\n", labels, m->totals.nivcsw);
+  }
+
+  header(out, "mon_backoff_seconds_total", "counter", "Seconds spent waiting to restart.");
+  for (monitor_t *m = monitors; m; m = m->next) {
+    service_labels(m, labels, sizeof(labels));
+    buffer_printf(out, "mon_backoff_seconds_total{%s} %g\n", labels, m->metrics.backoff / 1000.0);
+  }
+
+  header(out, "mon_handovers_total", "counter", "Planned handovers to a new generation.");
+  for (monitor_t *m = monitors; m; m = m->next) {
+    service_labels(m, labels, sizeof(labels));
+    buffer_printf(out, "mon_handovers_total{%s} %d\n", labels, m->handovers);
+  }
+
+  header(out, "mon_watchdog_kills_total", "counter", "Children stopped for exceeding a limit.");
+  for (monitor_t *m = monitors; m; m = m->next) {
+    service_labels(m, labels, sizeof(labels));
+    buffer_printf(out, "mon_watchdog_kills_total{%s,limit=\"rss\"} %u\n", labels, m->metrics.watchdog_rss);
+    buffer_printf(out, "mon_watchdog_kills_total{%s,limit=\"cpu\"} %u\n", labels, m->metrics.watchdog_cpu);
+  }
+
+  header(out, "mon_health_check_failures_total", "counter", "Failed health checks.");
+  for (monitor_t *m = monitors; m; m = m->next) {
+    service_labels(m, labels, sizeof(labels));
+    buffer_printf(out, "mon_health_check_failures_total{%s} %u\n", labels, m->metrics.health_failures);
+  }
+
+  header(out, "mon_restart_latency_seconds", "histogram", "Seconds from exit to respawn.");
+  for (monitor_t *m = monitors; m; m = m->next) {
+    service_labels(m, labels, sizeof(labels));
+    histogram(out, "mon_restart_latency_seconds", labels, &m->metrics.restart_latency);
+  }
+
+  header(out, "mon_ready_latency_seconds", "histogram", "Seconds from spawn to ready.");
+  for (monitor_t *m = monitors; m; m = m->next) {
+    service_labels(m, labels, sizeof(labels));
+    histogram(out, "mon_ready_latency_seconds", labels, &m->metrics.ready_latency);
+  }
+
+  header(out, "mon_hook_duration_seconds", "histogram", "Seconds hooks ran for.");
+  for (monitor_t *m = monitors; m; m = m->next) {
+    service_labels(m, labels, sizeof(labels));
+    snprintf(hook, sizeof(hook), "%s,hook=\"on-restart\"", labels);
+    histogram(out, "mon_hook_duration_seconds", hook, &m->metrics.restart_hook);
+    snprintf(hook, sizeof(hook), "%s,hook=\"on-error\"", labels);
+    histogram(out, "mon_hook_duration_seconds", hook, &m->metrics.error_hook);
+  }
+}
+
+/*
+ * Rewrite the textfile atomically.
+ */
+
+static void
+write_file(loop_timer_t *timer) {
+  char tmp[PATH_MAX];
+  buffer_t out = {0};
+
+  metrics_render(&out);
+  snprintf(tmp, sizeof(tmp), "%s.tmp", file_path);
+
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (-1 == fd) {
+    log("metrics: failed to open %s", tmp);
+    free(out.data);
+    return;
+  }
+
+  if (out.len != write(fd, out.data, out.len) || -1 == rename(tmp, file_path)) {
+    log("metrics: failed to write %s", file_path);
+    unlink(tmp);
+  }
+
+  close(fd);
+  free(out.data);
+}
+
+/*
+ * Rewrite a textfile collector file at `path` periodically.
+ */
+
+void
+metrics_file(const char *path) {
+  file_path = path;
+  loop_timer_init(&file_timer, write_file, NULL);
+  loop_timer_start(&file_timer, 0, METRICS_INTERVAL);
+}
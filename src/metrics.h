@@ -0,0 +1,67 @@
+//
+// metrics.h
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <signal.h>
+#include "control.h"
+
+/*
+ * Histogram buckets.
+ */
+
+#define METRICS_BUCKETS 14
+
+/*
+ * Interval --metrics files are rewritten at in ms.
+ */
+
+#ifndef METRICS_INTERVAL
+#define METRICS_INTERVAL 10000
+#endif
+
+/*
+ * Latency histogram.
+ */
+
+typedef struct {
+  uint64_t buckets[METRICS_BUCKETS];
+  uint64_t count;
+  int64_t sum;
+} histogram_t;
+
+/*
+ * Per-monitor metrics.
+ */
+
+typedef struct {
+  uint32_t exit_codes[256];
+  uint32_t signals[NSIG];
+  int64_t backoff;
+  int64_t exited_at;
+  uint32_t watchdog_rss;
+  uint32_t watchdog_cpu;
+  uint32_t health_failures;
+  histogram_t restart_latency;
+  histogram_t ready_latency;
+  histogram_t restart_hook;
+  histogram_t error_hook;
+} metrics_t;
+
+// prototypes
+
+void
+histogram_observe(histogram_t *h, int64_t ms);
+
+void
+metrics_render(buffer_t *out);
+
+void
+metrics_file(const char *path);
+
+#endif /* METRICS_H */
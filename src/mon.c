@@ -1,4 +1,3 @@
-
 //
 // mon.c
 //
@@ -7,18 +6,31 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <setjmp.h>
 #include <unistd.h>
 #include <assert.h>
+#include <errno.h>
 #include <string.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/time.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
+#include <sys/signalfd.h>
 #include "commander.h"
+#include "control.h"
+#include "status.h"
+#include "hook.h"
+#include "watchdog.h"
+#include "notify.h"
+#include "config.h"
+#include "spawn.h"
+#include "mon.h"
 #include "ms.h"
 
 /*
@@ -31,177 +43,214 @@
  * Log prefix.
  */
 
-static const char *prefix = NULL;
+const char *prefix = NULL;
 
 /*
- * Monitor.
+ * Logfile used when daemonized.
  */
 
-typedef struct {
-  const char *pidfile;
-  const char *mon_pidfile;
-  const char *logfile;
-  const char *on_error;
-  const char *on_restart;
-  int64_t last_restart_at;
-  int64_t clock;
-  int daemon;
-  int sleepsec;
-  int max_attempts;
-  int attempts;
-  bool show_status;
-} monitor_t;
+static const char *logfile = "mon.log";
 
 /*
- * Monitor instance.
+ * Logfile rotation.
  */
 
-static monitor_t monitor;
+static off_t log_max_size = 0;
+static int64_t log_max_age = 0;
+static int log_keep = 5;
 
 /*
- * Logger.
+ * Control socket path.
  */
 
-#define log(fmt, args...) \
-  do { \
-    if (prefix) { \
-      printf("mon : %s : " fmt "\n", prefix, ##args); \
-      fflush(stdout); \
-    } else { \
-      printf("mon : " fmt "\n", ##args); \
-      fflush(stdout); \
-    } \
-  } while(0)
+static const char *control_path = NULL;
 
 /*
- * Output error `msg`.
+ * Metrics textfile path.
  */
 
-void
-error(char *msg) {
-  fprintf(stderr, "Error: %s\n", msg);
-  exit(1);
-}
+static const char *metrics_path = NULL;
 
 /*
- * Check if process of `pid` is alive.
+ * Mon pidfile.
  */
 
-int
-alive(pid_t pid) {
-  return 0 == kill(pid, 0);
-}
+static const char *mon_pidfile = NULL;
 
 /*
- * Return a timestamp in milliseconds.
+ * Daemonize mon.
  */
 
-int64_t
-timestamp() {
-  struct timeval tv;
-  int ret = gettimeofday(&tv, NULL);
-  if (-1 == ret) return -1;
-  return (int64_t) ((int64_t) tv.tv_sec * 1000 + (int64_t) tv.tv_usec / 1000);
-}
+static int should_daemonize = 0;
 
 /*
- * Write `pid` to `file`.
+ * Show status of --pidfile, --control or
+ * the pidfiles and sockets given.
  */
 
-void
-write_pidfile(const char *file, pid_t pid) {
-  char buf[32] = {0};
-  snprintf(buf, 32, "%d", pid);
-  int fd = open(file, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
-  if (fd < 0) perror("open()");
-  write(fd, buf, 32);
-  close(fd);
-}
+static bool show_status = false;
+static int status_format = STATUS_TEXT;
 
 /*
- * Read pid `file`.
+ * Characters requiring /bin/sh to interpret a command.
  */
 
-pid_t
-read_pidfile(const char *file) {
-  off_t size;
-  struct stat s;
+static const char *shell_chars = "|&;<>()$`\\\"'*?[]#~{}!\n";
 
-  // stat
-  if (stat(file, &s) < 0) {
-    perror("stat()");
-    exit(1);
-  }
+/*
+ * Options applied to monitors defined
+ * after them, set by flags preceding
+ * the first command.
+ */
 
-  size = s.st_size;
+static monitor_t defaults;
 
-  // opens
-  int fd = open(file, O_RDONLY, 0);
-  if (fd < 0) {
-    perror("open()");
-    exit(1);
-  }
+/*
+ * Monitors, in the order given.
+ */
 
-  // read
-  char buf[size];
-  if (size != read(fd, buf, size)) {
-    perror("read()");
-    exit(1);
-  }
+monitor_t *monitors = NULL;
+int nmonitors = 0;
+
+/*
+ * Signals handled from the loop through a signalfd.
+ */
+
+static loop_io_t signals;
+
+/*
+ * Shutting down on SIGTERM, SIGQUIT or SIGINT.
+ */
+
+static bool shutting_down = false;
+
+/*
+ * Config file, reloaded on SIGHUP or when written.
+ */
+
+static const char *config_path = NULL;
+
+/*
+ * Program options, applied to config entries.
+ */
+
+static command_t *options = NULL;
+
+/*
+ * Monitor options apply to while reading the config,
+ * and the one options preceding the first section
+ * apply to.
+ */
+
+static monitor_t *configuring = NULL;
+static monitor_t config_defaults;
+
+/*
+ * Reloaded config data, freed along with the
+ * last monitor pointing into it.
+ */
+
+typedef struct source {
+  char *data;
+  int refs;
+} source_t;
+
+/*
+ * Monitors being loaded, freed when the config
+ * turns out to be invalid.
+ */
+
+static monitor_t *loading = NULL;
+
+/*
+ * Removed monitors, freed once no hook refers to them.
+ */
+
+static monitor_t *graveyard = NULL;
+
+/*
+ * Return the log prefix for `monitor`.
+ */
 
-  return atoi(buf);
+const char *
+monitor_prefix(monitor_t *monitor) {
+  if (monitor->prefix) return monitor->prefix;
+  if (prefix) return prefix;
+  if (nmonitors > 1) return monitor->cmd;
+  return NULL;
 }
 
 /*
- * Output status of `pidfile`.
+ * Where error() returns to while reloading
+ * the config, rather than exiting.
  */
 
-void
-show_status_of(const char *pidfile) {
-  off_t size;
-  struct stat s;
+static jmp_buf *recover = NULL;
 
-  // stat
-  if (stat(pidfile, &s) < 0) {
-    perror("stat()");
-    exit(1);
-  }
+/*
+ * Output error `fmt`, and exit unless reloading.
+ */
 
-  size = s.st_size;
+void
+error(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  fprintf(stderr, "Error: ");
+  vfprintf(stderr, fmt, ap);
+  fprintf(stderr, "\n");
+  va_end(ap);
+  if (recover) longjmp(*recover, 1);
+  exit(1);
+}
 
-  // opens
-  int fd = open(pidfile, O_RDONLY, 0);
-  if (fd < 0) {
-    perror("open()");
-    exit(1);
-  }
+/*
+ * Escape `str` as the contents of a JSON string into `buf` of `len`.
+ */
 
-  // read
-  char buf[size];
-  if (size != read(fd, buf, size)) {
-    perror("read()");
-    exit(1);
+void
+json_escape(char *buf, size_t len, const char *str) {
+  size_t i = 0;
+
+  for (; *str && i + 7 < len; ++str) {
+    unsigned char c = *str;
+    switch (c) {
+      case '"': buf[i++] = '\\'; buf[i++] = '"'; break;
+      case '\\': buf[i++] = '\\'; buf[i++] = '\\'; break;
+      case '\n': buf[i++] = '\\'; buf[i++] = 'n'; break;
+      case '\t': buf[i++] = '\\'; buf[i++] = 't'; break;
+      default:
+        if (c < 0x20) i += sprintf(buf + i, "\\u%04x", c);
+        else buf[i++] = c;
+    }
   }
 
-  // uptime
-  time_t modified = s.st_mtime;
+  buf[i] = '\0';
+}
 
-  struct timeval t;
-  gettimeofday(&t, NULL);
-  time_t now = t.tv_sec;
-  time_t secs = now - modified;
+/*
+ * Return a monotonic timestamp in milliseconds,
+ * unaffected by adjustments of the system clock.
+ */
 
-  // status
-  pid_t pid = atoi(buf);
+int64_t
+timestamp() {
+  struct timespec ts;
+  int ret = clock_gettime(CLOCK_MONOTONIC, &ts);
+  if (-1 == ret) return -1;
+  return (int64_t) ((int64_t) ts.tv_sec * 1000 + (int64_t) ts.tv_nsec / 1000000);
+}
 
-  if (alive(pid)) {
-    char *str = milliseconds_to_long_string(secs * 1000);
-    printf("\e[90m%d\e[0m : \e[32malive\e[0m : uptime %s\e[m\n", pid, str);
-    free(str);
-  } else {
-    printf("\e[90m%d\e[0m : \e[31mdead\e[0m\n", pid);
-  }
+/*
+ * Write `pid` to `file`.
+ */
 
+void
+write_pidfile(const char *file, pid_t pid) {
+  char buf[32] = {0};
+  snprintf(buf, 32, "%d", pid);
+  int fd = open(file, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+  if (fd < 0) perror("open()");
+  write(fd, buf, 32);
   close(fd);
 }
 
@@ -211,10 +260,9 @@ show_status_of(const char *pidfile) {
 
 void
 redirect_stdio_to(const char *file) {
-  int logfd = open(file, O_WRONLY | O_CREAT | O_APPEND, 0755);
   int nullfd = open("/dev/null", O_RDONLY, 0);
 
-  if (-1 == logfd) {
+  if (-1 == output_file(file, log_max_size, log_max_age, log_keep)) {
     perror("open()");
     exit(1);
   }
@@ -225,25 +273,6 @@ redirect_stdio_to(const char *file) {
   }
 
   dup2(nullfd, 0);
-  dup2(logfd, 1);
-  dup2(logfd, 2);
-}
-
-/*
- * Graceful exit, signal process group.
- */
-
-void
-graceful_exit(int sig) {
-  int status;
-  pid_t pid = getpid();
-  log("shutting down");
-  log("kill(-%d, %d)", pid, sig);
-  kill(-pid, sig);
-  log("waiting for exit");
-  waitpid(read_pidfile(monitor.pidfile), &status, 0);
-  log("bye :)");
-  exit(0);
 }
 
 /*
@@ -261,58 +290,56 @@ daemonize() {
 }
 
 /*
- * Invoke the --on-restart command.
+ * Return the ms since the last restart.
  */
 
-void
-exec_restart_command(monitor_t *monitor, pid_t pid) {
-  char buf[1024] = {0};
-  snprintf(buf, 1024, "%s %d", monitor->on_restart, pid);
-  log("on restart `%s`", buf);
-  int status = system(buf);
-  if (status) log("exit(%d)", status);
+int64_t
+ms_since_last_restart(monitor_t *monitor) {
+  if (0 == monitor->last_restart_at) return 0;
+  int64_t now = timestamp();
+  return now - monitor->last_restart_at;
 }
 
 /*
- * Invoke the --on-error command.
+ * Return the timestamp of the oldest restart
+ * within the --window of `monitor`.
  */
 
-void
-exec_error_command(monitor_t *monitor, pid_t pid) {
-  char buf[1024] = {0};
-  snprintf(buf, 1024, "%s %d", monitor->on_error, pid);
-  log("on error `%s`", buf);
-  int status = system(buf);
-  if (status) log("exit(%d)", status);
+static int64_t
+oldest_restart(monitor_t *monitor) {
+  int i = monitor->restarts_head - monitor->attempts;
+  if (i < 0) i += monitor->max_attempts;
+  return monitor->restarts[i];
 }
 
 /*
- * Return the ms since the last restart.
+ * Expire restarts of `monitor` which fell
+ * out of the --window ending at `now`.
  */
 
-int64_t
-ms_since_last_restart(monitor_t *monitor) {
-  if (0 == monitor->last_restart_at) return 0;
-  int64_t now = timestamp();
-  return now - monitor->last_restart_at;
+static void
+expire_restarts(monitor_t *monitor, int64_t now) {
+  while (monitor->attempts && now - oldest_restart(monitor) > monitor->window) {
+    monitor->attempts--;
+  }
 }
 
 /*
- * Check if the maximum restarts within 60 seconds
- * have been exceeded and return 1, 0 otherwise.
+ * Record a restart at `now` and check if the maximum
+ * restarts within --window have been exceeded and
+ * return 1, 0 otherwise. Restart timestamps are kept
+ * in a ring of --attempts entries, oldest expiring
+ * first, so the check is O(1) amortized.
  */
 
 int
-attempts_exceeded(monitor_t *monitor, int64_t ms) {
-  monitor->attempts++;
-  monitor->clock -= ms;
+attempts_exceeded(monitor_t *monitor, int64_t now) {
+  if (monitor->max_attempts <= 0) return 1;
 
-  // reset
-  if (monitor->clock <= 0) {
-    monitor->clock = 60000;
-    monitor->attempts = 0;
-    return 0;
-  }
+  expire_restarts(monitor, now);
+  monitor->restarts[monitor->restarts_head] = now;
+  monitor->restarts_head = (monitor->restarts_head + 1) % monitor->max_attempts;
+  if (monitor->attempts < monitor->max_attempts) monitor->attempts++;
 
   // all good
   if (monitor->attempts < monitor->max_attempts) return 0;
@@ -321,237 +348,1801 @@ attempts_exceeded(monitor_t *monitor, int64_t ms) {
 }
 
 /*
- * Monitor the given `cmd`.
+ * Split `cmd` on whitespace into a NULL-terminated
+ * argv, or return NULL when `force` is not set and
+ * the command requires a shell.
  */
 
-void
-start(const char *cmd, monitor_t *monitor) {
-exec: {
-  pid_t pid = fork();
-  int status;
-
-  switch (pid) {
-    case -1:
-      perror("fork()");
-      exit(1);
-    case 0:
-      signal(SIGTERM, SIG_DFL);
-      signal(SIGQUIT, SIG_DFL);
-      log("sh -c \"%s\"", cmd);
-      execl("/bin/sh", "sh", "-c", cmd, 0);
-      perror("execl()");
-      exit(1);
-    default:
-      log("child %d", pid);
-
-      // write pidfile
-      if (monitor->pidfile) {
-        log("write pid to %s", monitor->pidfile);
-        write_pidfile(monitor->pidfile, pid);
-      }
-
-      // wait for exit
-      waitpid(pid, &status, 0);
+char **
+split_command(const char *cmd, int force) {
+  if (!force && strpbrk(cmd, shell_chars)) return NULL;
 
-      // signalled
-      if (WIFSIGNALED(status)) {
-        log("signal(%s)", strsignal(WTERMSIG(status)));
-        log("sleep(%d)", monitor->sleepsec);
-        sleep(monitor->sleepsec);
-        goto error;
-      }
+  size_t len = strlen(cmd);
+  char **argv = malloc((len / 2 + 2) * sizeof(char *));
+  char *buf = strdup(cmd + strspn(cmd, " \t"));
+  if (!argv || !buf) error("out of memory");
 
-      // check status
-      if (WEXITSTATUS(status)) {
-        log("exit(%d)", WEXITSTATUS(status));
-        log("sleep(%d)", monitor->sleepsec);
-        sleep(monitor->sleepsec);
-        goto error;
-      }
+  int argc = 0;
+  char *save;
+  for (char *tok = strtok_r(buf, " \t", &save); tok; tok = strtok_r(NULL, " \t", &save)) {
+    argv[argc++] = tok;
+  }
+  argv[argc] = NULL;
 
-      // restart
-      error: {
-        if (monitor->on_restart) exec_restart_command(monitor, pid);
-        int64_t ms = ms_since_last_restart(monitor);
-        monitor->last_restart_at = timestamp();
-        log("last restart %s ago", milliseconds_to_long_string(ms));
-        log("%d attempts remaining", monitor->max_attempts - monitor->attempts);
-
-        if (attempts_exceeded(monitor, ms)) {
-          char *time = milliseconds_to_long_string(60000 - monitor->clock);
-          log("%d restarts within %s, bailing", monitor->max_attempts, time);
-          if (monitor->on_error) exec_error_command(monitor, pid);
-          log("bye :)");
-          exit(2);
-        }
-
-        goto exec;
-      }
+  if (!argc) {
+    free(buf);
+    free(argv);
+    return NULL;
   }
+
+  return argv;
 }
+
+/*
+ * Check if `monitor` waits for its children to be ready.
+ */
+
+static bool
+readiness(monitor_t *monitor) {
+  return monitor->notify || monitor->ready.probe;
 }
 
 /*
- * --log <path>
+ * Send `sig` to the process group of child `pid`
+ * of `monitor`.
  */
 
 static void
-on_log(command_t *self) {
-  monitor_t *monitor = (monitor_t *) self->data;
-  monitor->logfile = self->arg;
+signal_child(monitor_t *monitor, pid_t pid, int sig) {
+  mlog(monitor, "kill(-%d, %d)", pid, sig);
+  kill(-pid, sig);
 }
 
 /*
- * --sleep <sec>
+ * Kill the previous generation of `monitor` which
+ * hasn't drained within --drain-timeout.
  */
 
 static void
-on_sleep(command_t *self) {
-  monitor_t *monitor = (monitor_t *) self->data;
-  monitor->sleepsec = atoi(self->arg);
+on_drain(loop_timer_t *timer) {
+  monitor_t *monitor = timer->data;
+  if (monitor->old_pid) signal_child(monitor, monitor->old_pid, SIGKILL);
 }
 
 /*
- * --daemonize
+ * Stop the previous generation of `monitor`, now
+ * that the new one is ready.
  */
 
 static void
-on_daemonize(command_t *self) {
-  monitor_t *monitor = (monitor_t *) self->data;
-  monitor->daemon = 1;
+retire(monitor_t *monitor) {
+  signal_child(monitor, monitor->old_pid, monitor->stop_signal);
+  loop_timer_start(&monitor->drain_timer, monitor->drain_timeout, 0);
 }
 
 /*
- * --pidfile <path>
+ * Mark the child of `monitor` ready, writing its pidfile
+ * and running the --on-restart hook deferred until now.
  */
 
-static void
-on_pidfile(command_t *self) {
-  monitor_t *monitor = (monitor_t *) self->data;
-  monitor->pidfile = self->arg;
+void
+ready(monitor_t *monitor) {
+  monitor->ready_at = timestamp();
+
+  if (readiness(monitor)) {
+    int64_t ms = monitor->ready_at - monitor->started_at;
+    char time[MS_LEN];
+    mlog(monitor, "ready in %s", milliseconds_to_string_r(ms, time, sizeof(time)));
+    histogram_observe(&monitor->metrics.ready_latency, ms);
+    hook_emit(monitor, "ready", ",\"pid\":%d,\"latency\":%lld", monitor->pid, (long long) ms);
+    if (monitor->ready.probe) loop_timer_stop(&monitor->ready.timer);
+    loop_timer_stop(&monitor->ready_timer);
+  }
+
+  if (monitor->old_pid) retire(monitor);
+
+  if (monitor->restart_pending) {
+    monitor->restart_pending = false;
+    hook_exec(monitor, "on restart", monitor->on_restart, monitor->last_pid);
+  }
+
+  health_watch(monitor);
+
+  // write pidfile
+  if (monitor->pidfile) {
+    mlog(monitor, "write pid to %s", monitor->pidfile);
+    write_pidfile(monitor->pidfile, monitor->pid);
+  }
 }
 
 /*
- * --mon-pidfile <path>
+ * Spawn the command of `monitor`, see spawn_child().
+ */
+
+void
+start(monitor_t *monitor) {
+  int out[2] = { -1, -1 };
+  int err[2] = { -1, -1 };
+  int capture = should_daemonize || monitor->tag;
+
+  // capture stdio
+  if (capture && (-1 == pipe2(out, O_CLOEXEC) || -1 == pipe2(err, O_CLOEXEC))) {
+    perror("pipe2()");
+    exit(1);
+  }
+
+  if (monitor->argv) mlog(monitor, "exec \"%s\"", monitor->cmd);
+  else mlog(monitor, "sh -c \"%s\"", monitor->cmd);
+  output_flush();
+
+  pid_t pid = spawn_child(monitor, out[1], err[1]);
+
+  if (-1 == pid) {
+    perror("clone()");
+    exit(1);
+  }
+
+  mlog(monitor, "child %d", pid);
+  monitor->pid = pid;
+  monitor->started_at = timestamp();
+  monitor->started_time = time(NULL);
+  hook_emit(monitor, "start", ",\"pid\":%d", pid);
+  monitor->ready_at = 0;
+  watchdog_watch(monitor);
+
+  if (capture) {
+    char tag[256];
+    const char *name = monitor_prefix(monitor);
+    if (!name) name = monitor->cmd;
+    close(out[1]);
+    close(err[1]);
+    snprintf(tag, sizeof(tag), "%s : stdout : ", name);
+    output_watch(out[0], monitor->tag ? tag : NULL);
+    snprintf(tag, sizeof(tag), "%s : stderr : ", name);
+    output_watch(err[0], monitor->tag ? tag : NULL);
+  }
+
+  if (!readiness(monitor)) {
+    ready(monitor);
+    return;
+  }
+
+  health_ready(monitor);
+  if (monitor->ready_timeout) loop_timer_start(&monitor->ready_timer, monitor->ready_timeout, 0);
+}
+
+/*
+ * Stop the loop once every monitor has
+ * bailed and their hooks have completed,
+ * or every child has exited when shutting
+ * down.
  */
 
+void
+check_done() {
+  for (monitor_t *m = monitors; m; m = m->next) {
+    if (shutting_down ? m->pid || m->old_pid || m->lingering : !m->bailed && !m->stopped) return;
+  }
+  if (!shutting_down && hook_pending()) return;
+  loop_stop();
+}
+
 static void
-on_mon_pidfile(command_t *self) {
-  monitor_t *monitor = (monitor_t *) self->data;
-  monitor->mon_pidfile = self->arg;
+removed(monitor_t *monitor);
+
+/*
+ * Restart `monitor` once its sleep has elapsed,
+ * or bail when it restarts too often. Monitors
+ * removed by a config reload are removed here
+ * once their child has exited.
+ */
+
+void
+restart(loop_timer_t *timer) {
+  monitor_t *monitor = timer->data;
+  pid_t pid = monitor->last_pid;
+
+  if (monitor->removing) {
+    removed(monitor);
+    return;
+  }
+
+  if (monitor->on_restart) {
+    if (readiness(monitor)) monitor->restart_pending = true;
+    else hook_exec(monitor, "on restart", monitor->on_restart, pid);
+  }
+  int64_t ms = ms_since_last_restart(monitor);
+  int64_t now = monitor->last_restart_at = timestamp();
+  char ago[MS_LEN];
+  mlog(monitor, "last restart %s ago", milliseconds_to_long_string_r(ms, ago, sizeof(ago)));
+  expire_restarts(monitor, now);
+  mlog(monitor, "%d attempts remaining", monitor->max_attempts - monitor->attempts);
+  hook_emit(monitor, "restart", ",\"pid\":%d,\"attempts\":%d", pid, monitor->attempts + 1);
+
+  if (attempts_exceeded(monitor, now)) {
+    int64_t within = monitor->attempts ? now - oldest_restart(monitor) : 0;
+    char time[MS_LEN];
+    milliseconds_to_long_string_r(within, time, sizeof(time));
+    mlog(monitor, "%d restarts within %s, bailing", monitor->max_attempts, time);
+    if (monitor->on_error) hook_exec(monitor, "on error", monitor->on_error, pid);
+    hook_emit(monitor, "error", ",\"pid\":%d,\"attempts\":%d", pid, monitor->attempts);
+    monitor->bailed = true;
+    check_done();
+    return;
+  }
+
+  monitor->restarts_total++;
+  start(monitor);
+  histogram_observe(&monitor->metrics.restart_latency, timestamp() - monitor->metrics.exited_at);
 }
 
 /*
- * --status
+ * Return the delay before restarting `monitor` after a
+ * failure, of the class backing off from `sleep` whose
+ * last delay is `last`. The delay starts at `sleep`,
+ * grows by the --backoff factor up to --max-sleep, and
+ * resets once the child stayed up for --reset-after.
+ * Up to --jitter percent is added or removed so that
+ * many instances crashing together do not restart in
+ * lockstep.
+ */
+
+int64_t
+next_delay(monitor_t *monitor, int64_t *last, int64_t sleep) {
+  int64_t uptime = timestamp() - monitor->started_at;
+
+  // reset
+  if (uptime >= monitor->reset_after) *last = 0;
+
+  // grow
+  if (*last) {
+    *last = *last * monitor->backoff;
+    if (*last > monitor->max_sleep) *last = monitor->max_sleep;
+  } else {
+    *last = sleep;
+  }
+
+  int64_t delay = *last;
+
+  // jitter
+  if (monitor->jitter && delay) {
+    int64_t range = delay * monitor->jitter / 100;
+    if (range) delay += random() % (2 * range + 1) - range;
+  }
+
+  return delay;
+}
+
+/*
+ * Kill the child of `monitor` ignoring --stop-signal, or
+ * what is left of the process group of one which exited.
  */
 
 static void
-on_status(command_t *self) {
-  monitor_t *monitor = (monitor_t *) self->data;
-  monitor->show_status = true;
+on_kill(loop_timer_t *timer) {
+  monitor_t *monitor = timer->data;
+  if (monitor->pid) signal_child(monitor, monitor->pid, SIGKILL);
+  if (!monitor->lingering) return;
+
+  signal_child(monitor, monitor->lingering, SIGKILL);
+  monitor->lingering = 0;
+  if (monitor->removing && !monitor->pid) loop_timer_start(&monitor->timer, 0, 0);
+  check_done();
 }
 
 /*
- * --prefix
+ * Stop the child of `monitor` with --stop-signal, killing
+ * its process group when it hasn't exited within
+ * --stop-timeout. Unless shutting down the exit is
+ * handled like any other, restarting the child.
+ */
+
+void
+terminate(monitor_t *monitor) {
+  if (!monitor->pid || monitor->stopping) return;
+  signal_child(monitor, monitor->pid, monitor->stop_signal);
+  monitor->stopping = true;
+  loop_timer_start(&monitor->kill_timer, monitor->stop_timeout, 0);
+}
+
+/*
+ * Supervise the old generation of `monitor` again
+ * after a failed handover.
  */
 
 static void
-on_prefix(command_t *self) {
-  prefix = self->arg;
+resume(monitor_t *monitor) {
+  monitor->pid = monitor->old_pid;
+  monitor->started_at = monitor->old_started_at;
+  monitor->started_time = monitor->old_started_time;
+  monitor->ready_at = timestamp();
+  monitor->old_pid = 0;
+  watchdog_watch(monitor);
+  health_watch(monitor);
 }
 
 /*
- * --on-restart <cmd>
+ * Give up the handover of `monitor` to a new child which
+ * didn't get ready, killing it and keeping the old one.
  */
 
 static void
-on_restart(command_t *self) {
-  monitor_t *monitor = (monitor_t *) self->data;
-  monitor->on_restart = self->arg;
+abandon(monitor_t *monitor) {
+  pid_t pid = monitor->pid;
+  int64_t started_at = monitor->started_at;
+  time_t started_time = monitor->started_time;
+
+  mlog(monitor, "abandoning handover to %d", pid);
+  watchdog_unwatch(monitor);
+  resume(monitor);
+  monitor->old_pid = pid;
+  monitor->old_started_at = started_at;
+  monitor->old_started_time = started_time;
+  monitor->abandoned = true;
+  signal_child(monitor, pid, SIGKILL);
 }
 
 /*
- * --on-error <cmd>
+ * The child of `monitor` wasn't ready within --ready-timeout,
+ * stop it as failed, or abandon the handover to it.
  */
 
 static void
-on_error(command_t *self) {
-  monitor_t *monitor = (monitor_t *) self->data;
-  monitor->on_error = self->arg;
+on_unready(loop_timer_t *timer) {
+  monitor_t *monitor = timer->data;
+  char time[MS_LEN];
+
+  if (!monitor->pid || monitor->ready_at || monitor->stopping) return;
+  milliseconds_to_string_r(monitor->ready_timeout, time, sizeof(time));
+  mlog(monitor, "not ready within %s", time);
+  hook_emit(monitor, "unready", ",\"pid\":%d", monitor->pid);
+  health_unwatch(monitor);
+
+  if (monitor->old_pid) abandon(monitor);
+  else terminate(monitor);
 }
 
 /*
- * --attempts <n>
+ * Stop all children in parallel, see terminate(),
+ * exiting once they have. Signalled again while
+ * shutting down their process groups are killed.
  */
 
 static void
-on_attempts(command_t *self) {
-  monitor_t *monitor = (monitor_t *) self->data;
-  monitor->max_attempts = atoi(self->arg);
+stop_all() {
+  if (shutting_down) {
+    log("killing");
+    for (monitor_t *m = monitors; m; m = m->next) {
+      if (m->pid) signal_child(m, m->pid, SIGKILL);
+      if (m->old_pid) signal_child(m, m->old_pid, SIGKILL);
+      if (m->lingering) signal_child(m, m->lingering, SIGKILL);
+      m->lingering = 0;
+    }
+    check_done();
+    return;
+  }
+
+  log("shutting down");
+  shutting_down = true;
+
+  for (monitor_t *m = monitors; m; m = m->next) {
+    loop_timer_stop(&m->timer);
+    loop_timer_stop(&m->ready_timer);
+    watchdog_unwatch(m);
+    health_unwatch(m);
+    terminate(m);
+    if (m->old_pid) {
+      signal_child(m, m->old_pid, m->stop_signal);
+      loop_timer_start(&m->drain_timer, m->stop_timeout, 0);
+    }
+  }
+
+  check_done();
 }
 
 /*
- * [options] <cmd>
+ * Hand `monitor` over to a new generation of its child
+ * without downtime. The new child is spawned alongside
+ * the old one, which is sent SIGTERM once the new one
+ * is ready. Handovers are planned, so they don't count
+ * as restart attempts. Returns 0 when there is no
+ * running child to hand over from.
  */
 
 int
-main(int argc, char **argv){
-  monitor.pidfile = NULL;
-  monitor.mon_pidfile = NULL;
-  monitor.on_restart = NULL;
-  monitor.on_error = NULL;
-  monitor.logfile = "mon.log";
-  monitor.daemon = 0;
-  monitor.sleepsec = 1;
-  monitor.max_attempts = 10;
-  monitor.attempts = 0;
-  monitor.last_restart_at = 0;
-  monitor.clock = 60000;
-  monitor.show_status = false;
+handover(monitor_t *monitor) {
+  if (!monitor->pid || !monitor->ready_at || monitor->old_pid || monitor->stopping) return 0;
+  mlog(monitor, "handover from %d", monitor->pid);
+  hook_emit(monitor, "handover", ",\"pid\":%d", monitor->pid);
+  watchdog_unwatch(monitor);
+  health_unwatch(monitor);
+  monitor->old_pid = monitor->pid;
+  monitor->old_started_at = monitor->started_at;
+  monitor->old_started_time = monitor->started_time;
+  monitor->handovers++;
+  start(monitor);
+  return 1;
+}
 
-  command_t program;
-  command_init(&program, "mon", VERSION);
-  program.data = &monitor;
-  program.usage = "[options] <command>";
-  command_option(&program, "-l", "--log <path>", "specify logfile [mon.log]", on_log);
-  command_option(&program, "-s", "--sleep <sec>", "sleep seconds before re-executing [1]", on_sleep);
-  command_option(&program, "-S", "--status", "check status of --pidfile", on_status);
-  command_option(&program, "-p", "--pidfile <path>", "write pid to <path>", on_pidfile);
-  command_option(&program, "-m", "--mon-pidfile <path>", "write mon(1) pid to <path>", on_mon_pidfile);
-  command_option(&program, "-P", "--prefix <str>", "add a log prefix", on_prefix);
-  command_option(&program, "-d", "--daemonize", "daemonize the program", on_daemonize);
-  command_option(&program, "-a", "--attempts <n>", "retry attempts within 60 seconds [10]", on_attempts);
-  command_option(&program, "-R", "--on-restart <cmd>", "execute <cmd> on restarts", on_restart);
-  command_option(&program, "-E", "--on-error <cmd>", "execute <cmd> on error", on_error);
-  command_parse(&program, argc, argv);
+/*
+ * Handle exit `status` of the child of `monitor`,
+ * scheduling its restart.
+ */
+
+void
+exited(monitor_t *monitor, int status) {
+  int64_t delay = 0;
+
+  watchdog_unwatch(monitor);
+  health_unwatch(monitor);
+  loop_timer_stop(&monitor->ready_timer);
+
+  // the rest of its group may trap --stop-signal, killed by on_kill()
+  if (monitor->stopping && 0 == kill(-monitor->pid, 0)) monitor->lingering = monitor->pid;
+  else if (!monitor->lingering) loop_timer_stop(&monitor->kill_timer);
+
+  monitor->stopping = false;
+  monitor->last_pid = monitor->pid;
+  monitor->pid = 0;
+  monitor->last_status = status;
+  monitor->exits++;
+  monitor->metrics.exited_at = timestamp();
+  if (WIFSIGNALED(status)) monitor->metrics.signals[WTERMSIG(status)]++;
+  else monitor->metrics.exit_codes[WEXITSTATUS(status)]++;
+
+  int64_t uptime = timestamp() - monitor->started_at;
+  if (WIFSIGNALED(status)) {
+    hook_emit(monitor, "exit", ",\"pid\":%d,\"code\":null,\"signal\":%d,\"uptime\":%lld",
+      monitor->last_pid, WTERMSIG(status), (long long) uptime);
+  } else {
+    hook_emit(monitor, "exit", ",\"pid\":%d,\"code\":%d,\"signal\":null,\"uptime\":%lld",
+      monitor->last_pid, WEXITSTATUS(status), (long long) uptime);
+  }
+
+  if (WIFSIGNALED(status)) mlog(monitor, "signal(%s)", strsignal(WTERMSIG(status)));
+  else if (WEXITSTATUS(status)) mlog(monitor, "exit(%d)", WEXITSTATUS(status));
+
+  if (shutting_down) return;
+
+  if (monitor->removing) {
+    if (!monitor->lingering) loop_timer_start(&monitor->timer, 0, 0);
+    return;
+  }
+
+  // the new generation died before it was ready, not counting as an attempt
+  if (monitor->old_pid && !monitor->ready_at) {
+    mlog(monitor, "handover to %d failed, keeping %d", monitor->last_pid, monitor->old_pid);
+    resume(monitor);
+    return;
+  }
+
+  policy_t *policy = policy_match(monitor->policies, monitor->npolicies, status);
+
+  // --policy
+  if (policy) {
+    switch (policy->action) {
+      case POLICY_STOP:
+        mlog(monitor, "not restarting");
+        monitor->stopped = true;
+        return;
+      case POLICY_NOW:
+        // no sleep, still counting toward --attempts
+        break;
+      case POLICY_BACKOFF:
+        delay = next_delay(monitor, &policy->delay, policy->sleep);
+        break;
+    }
+  }
+
+  // failed
+  else if (WIFSIGNALED(status) || WEXITSTATUS(status)) {
+    delay = next_delay(monitor, &monitor->delay, monitor->sleep);
+  }
+
+  if (delay) {
+    char str[MS_LEN];
+    mlog(monitor, "sleep(%s)", milliseconds_to_string_r(delay, str, sizeof(str)));
+  }
+
+  monitor->metrics.backoff += delay;
+  loop_timer_start(&monitor->timer, delay, 0);
+}
+
+/*
+ * Return the monitor of child `pid`.
+ */
+
+monitor_t *
+monitor_of(pid_t pid) {
+  for (monitor_t *m = monitors; m; m = m->next) {
+    if (m->pid == pid) return m;
+  }
+  return NULL;
+}
+
+/*
+ * Return the microseconds of `tv`.
+ */
+
+static int64_t
+microseconds(struct timeval *tv) {
+  return (int64_t) tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
+/*
+ * Record resource usage `ru` of the run of `monitor` spawned
+ * at `started_at` (monotonic) and `started` (wall clock) which
+ * exited with `status` in its history and lifetime totals.
+ */
+
+void
+record_run(monitor_t *monitor, int64_t started_at, time_t started, int status, struct rusage *ru) {
+  run_t *run = &monitor->runs[monitor->runs_head];
+  monitor->runs_head = (monitor->runs_head + 1) % MON_HISTORY;
+
+  run->started = started;
+  run->duration = timestamp() - started_at;
+  run->status = status;
+  run->utime = microseconds(&ru->ru_utime);
+  run->stime = microseconds(&ru->ru_stime);
+  run->maxrss = ru->ru_maxrss;
+  run->minflt = ru->ru_minflt;
+  run->majflt = ru->ru_majflt;
+  run->nvcsw = ru->ru_nvcsw;
+  run->nivcsw = ru->ru_nivcsw;
+
+  run_t *t = &monitor->totals;
+  t->duration += run->duration;
+  t->utime += run->utime;
+  t->stime += run->stime;
+  if (run->maxrss > t->maxrss) t->maxrss = run->maxrss;
+  t->minflt += run->minflt;
+  t->majflt += run->majflt;
+  t->nvcsw += run->nvcsw;
+  t->nivcsw += run->nivcsw;
+
+  mlog(monitor, "rusage user %lldms sys %lldms maxrss %ldkb faults %ld/%ld ctxsw %ld/%ld"
+    , (long long) run->utime / 1000
+    , (long long) run->stime / 1000
+    , run->maxrss
+    , run->minflt
+    , run->majflt
+    , run->nvcsw
+    , run->nivcsw);
+}
+
+/*
+ * Handle exit `status` of the previous generation
+ * of `monitor`, completing the handover.
+ */
+
+static void
+retired(monitor_t *monitor, int status, struct rusage *ru) {
+  record_run(monitor, monitor->old_started_at, monitor->old_started_time, status, ru);
+  loop_timer_stop(&monitor->drain_timer);
+  if (monitor->abandoned) mlog(monitor, "handover to %d abandoned", monitor->old_pid);
+  else mlog(monitor, "handover from %d complete", monitor->old_pid);
+  monitor->abandoned = false;
+  monitor->old_pid = 0;
+}
+
+/*
+ * Return the monitor handing over from `pid`.
+ */
+
+static monitor_t *
+retiring_of(pid_t pid) {
+  for (monitor_t *m = monitors; m; m = m->next) {
+    if (pid == m->old_pid) return m;
+  }
+  return NULL;
+}
+
+/*
+ * Reap exited children without blocking.
+ */
+
+static void
+reap() {
+  struct rusage ru;
+  monitor_t *monitor;
+  int status;
+  pid_t pid;
+
+  while ((pid = wait4(-1, &status, WNOHANG, &ru)) > 0) {
+    if (hook_reap(pid, status)) continue;
+    if (output_reap(pid, status)) continue;
+    if (health_reap(pid, status)) continue;
+
+    if ((monitor = monitor_of(pid))) {
+      record_run(monitor, monitor->started_at, monitor->started_time, status, &ru);
+      exited(monitor, status);
+    } else if ((monitor = retiring_of(pid))) {
+      retired(monitor, status, &ru);
+    }
+  }
+
+  check_done();
+}
+
+/*
+ * Set up `monitor` and spawn its child, returning
+ * -1 when its --listen sockets can't be bound.
+ */
+
+static int
+launch(monitor_t *monitor) {
+  if (monitor->max_attempts > 0) {
+    monitor->restarts = calloc(monitor->max_attempts, sizeof(int64_t));
+    if (!monitor->restarts) error("out of memory");
+  }
+  if (EXEC_SHELL != monitor->exec_mode) {
+    monitor->argv = split_command(monitor->cmd, EXEC_DIRECT == monitor->exec_mode);
+  }
+  loop_timer_init(&monitor->timer, restart, monitor);
+  loop_timer_init(&monitor->kill_timer, on_kill, monitor);
+  loop_timer_init(&monitor->drain_timer, on_drain, monitor);
+  loop_timer_init(&monitor->ready_timer, on_unready, monitor);
+  health_init(monitor);
+  notify_init(monitor);
+
+  if (-1 == listen_init(monitor)) {
+    monitor->bailed = true;
+    return -1;
+  }
+
+  start(monitor);
+  return 0;
+}
+
+/*
+ * Append `monitor` to the monitors.
+ */
+
+static void
+append(monitor_t *monitor) {
+  monitor_t **tail = &monitors;
+  while (*tail) tail = &(*tail)->next;
+  *tail = monitor;
+  monitor->next = NULL;
+  nmonitors++;
+}
+
+/*
+ * Add `monitor` while supervising.
+ */
+
+static void
+add(monitor_t *monitor) {
+  append(monitor);
+  if (-1 == launch(monitor)) mlog(monitor, "failed to start");
+}
+
+/*
+ * Drop a reference to `source`, freeing it with the last.
+ */
+
+static void
+release(source_t *source) {
+  if (!source || --source->refs) return;
+  free(source->data);
+  free(source);
+}
+
+/*
+ * Free `monitor`, no longer supervised.
+ */
+
+static void
+free_monitor(monitor_t *monitor) {
+  if (monitor->argv) {
+    free(monitor->argv[0]);
+    free(monitor->argv);
+  }
+  free(monitor->restarts);
+  free(monitor->definition);
+  release(monitor->source);
+  free(monitor);
+}
+
+/*
+ * Free the removed monitors no hook refers to anymore.
+ * This runs before waiting for events, so none can be
+ * pending for them.
+ */
+
+static void
+sweep() {
+  monitor_t **p = &graveyard;
+
+  while (*p) {
+    monitor_t *m = *p;
+    if (hook_refs(m)) {
+      p = &m->next;
+    } else {
+      *p = m->next;
+      free_monitor(m);
+    }
+  }
+}
+
+/*
+ * Remove `monitor` now that its child has exited, adding
+ * the monitor replacing it if any, which takes over its
+ * --listen sockets when unchanged. Hooks in flight may
+ * still refer to it, so it is freed by sweep().
+ */
+
+static void
+removed(monitor_t *monitor) {
+  monitor_t **p = &monitors;
+  while (*p != monitor) p = &(*p)->next;
+  *p = monitor->next;
+  nmonitors--;
+
+  loop_timer_close(&monitor->timer);
+  loop_timer_close(&monitor->kill_timer);
+  loop_timer_close(&monitor->drain_timer);
+  loop_timer_close(&monitor->ready_timer);
+  health_close(monitor);
+  notify_close(monitor);
+  if (monitor->replacement) listen_handover(monitor, monitor->replacement);
+  else listen_close(monitor);
+  mlog(monitor, "removed");
+
+  monitor_t *replacement = monitor->replacement;
+  monitor->next = graveyard;
+  graveyard = monitor;
+  if (replacement) add(replacement);
+}
+
+/*
+ * Remove `monitor` once its child has been stopped,
+ * then add `replacement` when non-NULL.
+ */
+
+static void
+remove_monitor(monitor_t *monitor, monitor_t *replacement) {
+  monitor->removing = true;
+  monitor->replacement = replacement;
+  loop_timer_stop(&monitor->timer);
+
+  if (monitor->old_pid) signal_child(monitor, monitor->old_pid, monitor->stop_signal);
+
+  if (monitor->pid) {
+    watchdog_unwatch(monitor);
+    health_unwatch(monitor);
+    terminate(monitor);
+  } else {
+    loop_timer_start(&monitor->timer, 0, 0);
+  }
+}
+
+/*
+ * Apply config `entry` of the file at `path` through the
+ * option it is named after. Options of mon(1) itself are
+ * only allowed before the first section, and are ignored
+ * when `reloading`.
+ */
+
+static void
+configure(const char *path, config_entry_t *entry, bool reloading) {
+  static const char *globals[] = {
+    "log", "log-max-size", "log-max-age", "log-keep", "log-compress",
+    "control", "metrics", "mon-pidfile", "daemonize", "prefix",
+    "events", "max-hooks", NULL
+  };
+  char flag[64];
+
+  for (int i = 0; globals[i]; ++i) {
+    if (strcmp(globals[i], entry->key)) continue;
+    if (reloading && !entry->section) return;
+    if (!entry->section) break;
+    error("%s:%d: `%s` must precede the first section", path, entry->line, entry->key);
+  }
+
+  if (!strcmp("help", entry->key)
+    || !strcmp("version", entry->key)
+    || !strcmp("status", entry->key)
+    || !strcmp("format", entry->key)
+    || !strcmp("config", entry->key)) goto unknown;
+
+  snprintf(flag, sizeof(flag), "--%s", entry->key);
+
+  for (int i = 0; i < options->option_count; ++i) {
+    command_option_t *option = &options->options[i];
+    if (strcmp(flag, option->large)) continue;
+
+    if (option->required_arg && !*entry->value) {
+      error("%s:%d: %s %s required", path, entry->line, entry->key, option->argname);
+    }
+
+    options->arg = *entry->value ? entry->value : NULL;
+    option->cb(options);
+    return;
+  }
+
+unknown:
+  error("%s:%d: unknown option `%s`", path, entry->line, entry->key);
+}
+
+/*
+ * Return the monitor named `name` in `list`.
+ */
+
+static monitor_t *
+named(monitor_t *list, const char *name) {
+  for (monitor_t *m = list; m; m = m->next) {
+    if (m->prefix && !strcmp(name, m->prefix)) return m;
+  }
+  return NULL;
+}
+
+/*
+ * Return the monitors of each section of `config` read
+ * from `path`, each named after its section. Their
+ * definitions, the entries applying to them, tell
+ * which changed on reload. Errors exit, or return to
+ * reload() through error() while `loading` holds the
+ * monitors loaded so far.
+ */
+
+static monitor_t *
+load_config(const char *path, config_t *config, bool reloading) {
+  static buffer_t common = { NULL, 0, 0 };
+  monitor_t **tail = &loading;
+  monitor_t *monitor = NULL;
+
+  // options preceding the first section
+  config_defaults = defaults;
+  configuring = &config_defaults;
+  common.len = 0;
+  buffer_printf(&common, "");
+
+  for (int i = 0; i < config->len; ++i) {
+    config_entry_t *entry = &config->entries[i];
+    if (entry->section) continue;
+    configure(path, entry, reloading);
+    buffer_printf(&common, "%s\t%s\n", entry->key, entry->value);
+  }
+
+  // sections
+  for (int i = 0; i < config->len; ++i) {
+    config_entry_t *entry = &config->entries[i];
+    if (!entry->section) continue;
+
+    if (!monitor || entry->section != monitor->prefix) {
+      if (named(loading, entry->section)) {
+        error("%s:%d: duplicate section `%s`", path, entry->line, entry->section);
+      }
+
+      monitor = malloc(sizeof(monitor_t));
+      if (!monitor) error("out of memory");
+      *monitor = config_defaults;
+      monitor->prefix = entry->section;
+      monitor->cmd = NULL;
+      monitor->next = NULL;
+      *tail = monitor;
+      tail = &monitor->next;
+    }
+
+    configuring = monitor;
+    if (strcmp("cmd", entry->key)) configure(path, entry, reloading);
+    else if (*entry->value) monitor->cmd = entry->value;
+    configuring = &config_defaults;
+  }
+
+  configuring = NULL;
+
+  // definitions
+  for (monitor_t *m = loading; m; m = m->next) {
+    if (!m->cmd) {
+      error("%s: [%s] requires `cmd`", path, m->prefix);
+    }
+
+    buffer_t def = { NULL, 0, 0 };
+    buffer_printf(&def, "%s", common.data);
+    for (int i = 0; i < config->len; ++i) {
+      config_entry_t *entry = &config->entries[i];
+      if (entry->section != m->prefix) continue;
+      buffer_printf(&def, "%s\t%s\n", entry->key, entry->value);
+    }
+    m->definition = def.data;
+  }
+
+  monitor_t *list = loading;
+  loading = NULL;
+  return list;
+}
+
+/*
+ * Reload the config file, restarting only the services
+ * whose definition changed and adding or removing those
+ * added or removed. Services given on the command-line
+ * and mon(1)'s own options are left untouched.
+ */
+
+static void
+reload() {
+  config_t config;
+  jmp_buf jmp;
+
+  if (shutting_down) return;
+  log("reloading %s", config_path);
+
+  if (-1 == config_read(config_path, &config)) {
+    log("failed to load %s, keeping the running config", config_path);
+    return;
+  }
+
+  // applied only once it all loaded
+  if (setjmp(jmp)) {
+    recover = NULL;
+    configuring = NULL;
+    while (loading) {
+      monitor_t *m = loading;
+      loading = m->next;
+      free_monitor(m);
+    }
+    config_free(&config);
+    log("failed to load %s, keeping the running config", config_path);
+    return;
+  }
+
+  recover = &jmp;
+  monitor_t *loaded = load_config(config_path, &config, true);
+  recover = NULL;
+
+  // held until the end of the reload
+  source_t *source = malloc(sizeof(source_t));
+  if (!source) error("out of memory");
+  source->data = config.data;
+  source->refs = 1;
+  for (monitor_t *n = loaded; n; n = n->next) {
+    n->source = source;
+    source->refs++;
+  }
+
+  // changed and removed
+  for (monitor_t *m = monitors; m; m = m->next) {
+    if (!m->definition || m->removing) continue;
+
+    monitor_t **p = &loaded;
+    while (*p && strcmp(m->prefix, (*p)->prefix)) p = &(*p)->next;
+    monitor_t *n = *p;
+
+    if (!n) {
+      mlog(m, "removing");
+      remove_monitor(m, NULL);
+    } else if (strcmp(n->definition, m->definition)) {
+      *p = n->next;
+      mlog(m, "changed, restarting");
+      remove_monitor(m, n);
+    } else {
+      *p = n->next;
+      free_monitor(n);
+    }
+  }
+
+  // added, or replacing one still being removed
+  for (monitor_t *n = loaded, *next; n; n = next) {
+    next = n->next;
+
+    monitor_t *m = named(monitors, n->prefix);
+    if (m && m->removing) {
+      if (m->replacement) free_monitor(m->replacement);
+      m->replacement = n;
+      continue;
+    }
+
+    mlog(n, "adding");
+    add(n);
+  }
+
+  // entries of running monitors point into the data
+  release(source);
+  free(config.entries);
+}
+
+/*
+ * Signals delivered. SIGCHLD coalesces so every
+ * child is reaped regardless, SIGUSR2 hands all
+ * monitors over to a new generation, SIGHUP reloads
+ * the config, and SIGTERM, SIGQUIT or SIGINT shut down.
+ */
+
+static void
+on_signal(loop_io_t *io, uint32_t events) {
+  struct signalfd_siginfo info;
+
+  while (sizeof(info) == read(io->fd, &info, sizeof(info))) {
+    switch (info.ssi_signo) {
+      case SIGUSR2:
+        if (shutting_down) break;
+        log("handover");
+        for (monitor_t *m = monitors; m; m = m->next) handover(m);
+        break;
+      case SIGHUP:
+        if (config_path) reload();
+        else log("no --config to reload");
+        break;
+      case SIGTERM:
+      case SIGQUIT:
+      case SIGINT:
+        stop_all();
+        break;
+    }
+  }
+
+  reap();
+}
+
+/*
+ * Add the signals handled from the loop to `set`.
+ */
+
+static void
+handled_signals(sigset_t *set) {
+  sigemptyset(set);
+  sigaddset(set, SIGCHLD);
+  sigaddset(set, SIGUSR2);
+  sigaddset(set, SIGHUP);
+  sigaddset(set, SIGTERM);
+  sigaddset(set, SIGQUIT);
+  sigaddset(set, SIGINT);
+}
+
+/*
+ * Supervise all monitors until every one
+ * of them has bailed. SIGCHLD is delivered
+ * through a signalfd and restarts are
+ * scheduled with per-monitor timers,
+ * all dispatched by the event loop.
+ */
+
+void
+supervise() {
+  sigset_t set;
+  handled_signals(&set);
+
+  loop_init();
+  output_init(1);
+  if (control_path) control_listen(control_path);
+  if (metrics_path) metrics_file(metrics_path);
+
+  int fd = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (-1 == fd) {
+    perror("signalfd()");
+    exit(1);
+  }
+
+  loop_add(&signals, fd, EPOLLIN, on_signal, NULL);
+  watchdog_init();
+  if (config_path) {
+    config_watch(config_path, reload);
+    loop_prepare(sweep);
+  }
+
+  for (monitor_t *m = monitors; m; m = m->next) {
+    if (-1 == launch(m)) exit(1);
+  }
+
+  output_defer(1);
+  loop_run();
+  output_defer(0);
+  hook_close();
+  control_close();
+  log("bye :)");
+  if (shutting_down) exit(0);
+  for (monitor_t *m = monitors; m; m = m->next) {
+    if (m->bailed) exit(2);
+  }
+  exit(0);
+}
+
+/*
+ * Return the monitor options apply to: the
+ * last command given, or the defaults when
+ * preceding the first command, or the one
+ * being configured when reading the config.
+ */
+
+static monitor_t *
+current(command_t *self) {
+  if (configuring) return configuring;
+
+  while (nmonitors < self->argc) {
+    monitor_t *monitor = malloc(sizeof(monitor_t));
+    if (!monitor) error("out of memory");
+    *monitor = defaults;
+    monitor->cmd = self->argv[nmonitors];
+
+    if (monitors) {
+      monitor_t *tail = monitors;
+      while (tail->next) tail = tail->next;
+      tail->next = monitor;
+    } else {
+      monitors = monitor;
+    }
+
+    nmonitors++;
+  }
+
+  if (!self->argc) return &defaults;
+  monitor_t *tail = monitors;
+  while (tail->next) tail = tail->next;
+  return tail;
+}
+
+/*
+ * --log <path>
+ */
+
+static void
+on_log(command_t *self) {
+  logfile = self->arg;
+}
+
+/*
+ * Parse duration `str` of `flag` such as "250ms" or "5m",
+ * bare numbers are milliseconds.
+ */
+
+static int64_t
+duration(const char *flag, const char *str) {
+  if (!strcmp("0", str)) return 0;
+  int64_t ms = string_to_milliseconds(str);
+  if (ms < 0) {
+    error("invalid %s `%s`", flag, str);
+  }
+  return ms;
+}
+
+/*
+ * Parse size `str` of `flag` such as "512kb" or "2gb",
+ * bare numbers are bytes.
+ */
+
+static int64_t
+size(const char *flag, const char *str) {
+  char *end;
+  int64_t n = strtoll(str, &end, 10);
+
+  if (end == str || n < 0) goto invalid;
+
+  switch (*end) {
+    case 'k': case 'K': n <<= 10; end++; break;
+    case 'm': case 'M': n <<= 20; end++; break;
+    case 'g': case 'G': n <<= 30; end++; break;
+  }
+
+  if ('b' == *end || 'B' == *end) end++;
+  if (*end) goto invalid;
+  return n;
+
+invalid:
+  error("invalid %s `%s`", flag, str);
+}
+
+/*
+ * --log-max-size <size>
+ */
+
+static void
+on_log_max_size(command_t *self) {
+  log_max_size = size("--log-max-size", self->arg);
+}
+
+/*
+ * --log-max-age <time>
+ */
+
+static void
+on_log_max_age(command_t *self) {
+  log_max_age = duration("--log-max-age", self->arg);
+}
+
+/*
+ * --log-keep <n>
+ */
+
+static void
+on_log_keep(command_t *self) {
+  log_keep = atoi(self->arg);
+  if (log_keep < 0) error("--log-keep must be positive");
+}
+
+/*
+ * --log-compress
+ */
+
+static void
+on_log_compress(command_t *self) {
+  output_compress(1);
+}
+
+/*
+ * --sleep <time>
+ */
+
+static void
+on_sleep(command_t *self) {
+  monitor_t *monitor = current(self);
+
+  // bare numbers remain seconds
+  if (strspn(self->arg, "0123456789") == strlen(self->arg)) {
+    monitor->sleep = atoll(self->arg) * 1000;
+  } else {
+    monitor->sleep = duration("--sleep", self->arg);
+  }
+}
+
+/*
+ * --backoff <factor>
+ */
+
+static void
+on_backoff(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->backoff = atof(self->arg);
+  if (monitor->backoff < 1) error("--backoff must be at least 1");
+}
+
+/*
+ * --max-sleep <time>
+ */
+
+static void
+on_max_sleep(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->max_sleep = duration("--max-sleep", self->arg);
+}
+
+/*
+ * --jitter <percent>
+ */
+
+static void
+on_jitter(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->jitter = atoi(self->arg);
+  if (monitor->jitter < 0 || monitor->jitter > 100) error("--jitter must be within 0-100");
+}
+
+/*
+ * --reset-after <time>
+ */
+
+static void
+on_reset_after(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->reset_after = duration("--reset-after", self->arg);
+}
+
+/*
+ * --daemonize
+ */
+
+static void
+on_daemonize(command_t *self) {
+  should_daemonize = 1;
+}
+
+/*
+ * --pidfile <path>
+ */
+
+static void
+on_pidfile(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->pidfile = self->arg;
+}
+
+/*
+ * --mon-pidfile <path>
+ */
+
+static void
+on_mon_pidfile(command_t *self) {
+  mon_pidfile = self->arg;
+}
+
+/*
+ * --status
+ */
+
+static void
+on_status(command_t *self) {
+  show_status = true;
+}
+
+/*
+ * --format <fmt>
+ */
+
+static void
+on_format(command_t *self) {
+  if (!strcmp("text", self->arg)) status_format = STATUS_TEXT;
+  else if (!strcmp("json", self->arg)) status_format = STATUS_JSON;
+  else if (!strcmp("tsv", self->arg)) status_format = STATUS_TSV;
+  else error("--format must be text, json or tsv");
+}
+
+/*
+ * --control <path>
+ */
+
+static void
+on_control(command_t *self) {
+  control_path = self->arg;
+}
+
+/*
+ * --metrics <path>
+ */
+
+static void
+on_metrics(command_t *self) {
+  metrics_path = self->arg;
+}
+
+/*
+ * --prefix
+ */
+
+static void
+on_prefix(command_t *self) {
+  if (self->argc || (configuring && configuring != &config_defaults)) current(self)->prefix = self->arg;
+  else prefix = self->arg;
+}
+
+/*
+ * --exec <mode>
+ */
+
+static void
+on_exec(command_t *self) {
+  monitor_t *monitor = current(self);
+  if (!strcmp("auto", self->arg)) monitor->exec_mode = EXEC_AUTO;
+  else if (!strcmp("shell", self->arg)) monitor->exec_mode = EXEC_SHELL;
+  else if (!strcmp("direct", self->arg)) monitor->exec_mode = EXEC_DIRECT;
+  else error("--exec must be auto, shell or direct");
+}
+
+/*
+ * --window <time>
+ */
+
+static void
+on_window(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->window = duration("--window", self->arg);
+}
+
+/*
+ * --on-restart <cmd>
+ */
+
+static void
+on_restart(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->on_restart = self->arg;
+}
+
+/*
+ * --on-error <cmd>
+ */
+
+static void
+on_error(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->on_error = self->arg;
+}
+
+/*
+ * --hook-timeout <time>
+ */
+
+static void
+on_hook_timeout(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->hook_timeout = duration("--hook-timeout", self->arg);
+}
+
+/*
+ * --max-hooks <n>
+ */
+
+static void
+on_max_hooks(command_t *self) {
+  int max = atoi(self->arg);
+  if (max < 1) error("--max-hooks must be at least 1");
+  hook_limit(max);
+}
+
+/*
+ * --tag
+ */
+
+static void
+on_tag(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->tag = true;
+}
+
+/*
+ * --events <cmd>
+ */
+
+static void
+on_events(command_t *self) {
+  hook_events(self->arg);
+}
+
+/*
+ * --attempts <n>
+ */
+
+static void
+on_attempts(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->max_attempts = atoi(self->arg);
+}
+
+/*
+ * --max-rss <size>
+ */
+
+static void
+on_max_rss(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->max_rss = size("--max-rss", self->arg);
+}
+
+/*
+ * --max-cpu <percent>
+ */
+
+static void
+on_max_cpu(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->max_cpu = atoi(self->arg);
+  if (monitor->max_cpu < 0) error("--max-cpu must be positive");
+}
+
+/*
+ * --max-cpu-for <time>
+ */
+
+static void
+on_max_cpu_for(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->max_cpu_time = duration("--max-cpu-for", self->arg);
+}
+
+/*
+ * --health <probe>
+ */
+
+static void
+on_health(command_t *self) {
+  monitor_t *monitor = current(self);
+  health_parse(&monitor->health, "--health", self->arg);
+}
+
+/*
+ * --notify
+ */
+
+static void
+on_notify(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->notify = true;
+}
+
+/*
+ * --ready <probe>
+ */
+
+static void
+on_ready(command_t *self) {
+  monitor_t *monitor = current(self);
+  health_parse(&monitor->ready, "--ready", self->arg);
+}
+
+/*
+ * --listen <addr>
+ */
+
+static void
+on_listen(command_t *self) {
+  monitor_t *monitor = current(self);
+  listen_add(monitor, self->arg);
+}
+
+/*
+ * Parse signal `str` of `flag` such as "TERM",
+ * "SIGINT" or "15".
+ */
+
+static int
+signal_of(const char *flag, const char *str) {
+  int sig = policy_signal(str);
+  if (-1 != sig) return sig;
+
+  sig = atoi(str);
+  if (sig > 0 && sig < NSIG) return sig;
+  error("invalid %s `%s`", flag, str);
+}
+
+/*
+ * --config <path>
+ */
+
+static void
+on_config(command_t *self) {
+  config_path = self->arg;
+}
+
+/*
+ * --policy <match>:<action>
+ */
+
+static void
+on_policy(command_t *self) {
+  monitor_t *monitor = current(self);
+  if (POLICY_MAX == monitor->npolicies) error("too many --policy rules");
+  if (-1 == policy_parse(&monitor->policies[monitor->npolicies], self->arg)) {
+    error("invalid --policy `%s`", self->arg);
+  }
+  monitor->npolicies++;
+}
+
+/*
+ * --stop-signal <sig>
+ */
+
+static void
+on_stop_signal(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->stop_signal = signal_of("--stop-signal", self->arg);
+}
+
+/*
+ * --stop-timeout <time>
+ */
+
+static void
+on_stop_timeout(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->stop_timeout = duration("--stop-timeout", self->arg);
+}
+
+/*
+ * --ready-timeout <time>
+ */
+
+static void
+on_ready_timeout(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->ready_timeout = duration("--ready-timeout", self->arg);
+}
+
+/*
+ * --drain-timeout <time>
+ */
+
+static void
+on_drain_timeout(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->drain_timeout = duration("--drain-timeout", self->arg);
+}
+
+/*
+ * --health-interval <time>
+ */
+
+static void
+on_health_interval(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->health.interval = duration("--health-interval", self->arg);
+  if (!monitor->health.interval) error("--health-interval must be positive");
+}
+
+/*
+ * --health-timeout <time>
+ */
+
+static void
+on_health_timeout(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->health.timeout = duration("--health-timeout", self->arg);
+  if (!monitor->health.timeout) error("--health-timeout must be positive");
+}
+
+/*
+ * --health-failures <n>
+ */
+
+static void
+on_health_failures(command_t *self) {
+  monitor_t *monitor = current(self);
+  monitor->health.max_failures = atoi(self->arg);
+  if (monitor->health.max_failures < 1) error("--health-failures must be at least 1");
+}
+
+/*
+ * [options] <cmd> [[options] <cmd> ...]
+ */
+
+int
+main(int argc, char **argv){
+  defaults.cmd = NULL;
+  defaults.argv = NULL;
+  defaults.exec_mode = EXEC_AUTO;
+  defaults.prefix = NULL;
+  defaults.pidfile = NULL;
+  defaults.on_restart = NULL;
+  defaults.on_error = NULL;
+  defaults.hook_timeout = 30000;
+  defaults.pid = 0;
+  defaults.last_pid = 0;
+  defaults.sleep = 1000;
+  defaults.max_sleep = 60000;
+  defaults.reset_after = 60000;
+  defaults.delay = 0;
+  defaults.started_at = 0;
+  defaults.started_time = 0;
+  defaults.restarts_total = 0;
+  defaults.exits = 0;
+  defaults.last_status = 0;
+  defaults.backoff = 1;
+  defaults.jitter = 0;
+  defaults.max_attempts = 10;
+  defaults.attempts = 0;
+  defaults.last_restart_at = 0;
+  defaults.window = 60000;
+  defaults.restarts = NULL;
+  defaults.restarts_head = 0;
+  defaults.bailed = false;
+  defaults.tag = false;
+  defaults.max_rss = 0;
+  defaults.max_cpu = 0;
+  defaults.max_cpu_time = 30000;
+  defaults.statm_fd = -1;
+  defaults.stat_fd = -1;
+  defaults.cpu_ticks = 0;
+  defaults.cpu_sampled_at = 0;
+  defaults.cpu_over_since = 0;
+  defaults.stopping = false;
+  defaults.lingering = 0;
+  memset(&defaults.health, 0, sizeof(health_t));
+  defaults.health.interval = 10000;
+  defaults.health.timeout = 5000;
+  defaults.health.max_failures = 3;
+  memset(&defaults.ready, 0, sizeof(health_t));
+  defaults.notify = false;
+  defaults.notify_socket[0] = '\0';
+  defaults.ready_at = 0;
+  defaults.restart_pending = false;
+  defaults.nlisten = 0;
+  defaults.old_pid = 0;
+  defaults.old_started_at = 0;
+  defaults.old_started_time = 0;
+  defaults.drain_timeout = 30000;
+  defaults.stop_signal = SIGTERM;
+  defaults.stop_timeout = 10000;
+  defaults.ready_timeout = 60000;
+  defaults.abandoned = false;
+  defaults.handovers = 0;
+  defaults.definition = NULL;
+  defaults.removing = false;
+  defaults.replacement = NULL;
+  defaults.npolicies = 0;
+  defaults.stopped = false;
+  memset(&defaults.metrics, 0, sizeof(metrics_t));
+  memset(defaults.runs, 0, sizeof(defaults.runs));
+  memset(&defaults.totals, 0, sizeof(run_t));
+  defaults.runs_head = 0;
+  defaults.next = NULL;
+
+  command_t program;
+  command_init(&program, "mon", VERSION);
+  program.usage = "[options] <command> [[options] <command> ...]";
+  command_option(&program, "-i", "--config <path>", "supervise the services of config <path>, reloaded on change", on_config);
+  command_option(&program, "-l", "--log <path>", "specify logfile [mon.log]", on_log);
+  command_option(&program, "-M", "--log-max-size <size>", "rotate the logfile once it reaches <size>", on_log_max_size);
+  command_option(&program, "-A", "--log-max-age <time>", "rotate the logfile once it is older than <time>", on_log_max_age);
+  command_option(&program, "-k", "--log-keep <n>", "rotated logfiles to keep [5]", on_log_keep);
+  command_option(&program, "-z", "--log-compress", "gzip rotated logfiles in the background", on_log_compress);
+  command_option(&program, "-s", "--sleep <time>", "sleep before re-executing, bare numbers are seconds [1s]", on_sleep);
+  command_option(&program, "-b", "--backoff <factor>", "multiply the sleep on each consecutive failure [1]", on_backoff);
+  command_option(&program, "-B", "--max-sleep <time>", "maximum sleep when backing off [1m]", on_max_sleep);
+  command_option(&program, "-j", "--jitter <percent>", "randomize the sleep by up to <percent> [0]", on_jitter);
+  command_option(&program, "-u", "--reset-after <time>", "reset the sleep after <time> of uptime [1m]", on_reset_after);
+  command_option(&program, "-S", "--status", "check status of --pidfile, --control, or pidfiles, sockets and dirs given", on_status);
+  command_option(&program, "-f", "--format <fmt>", "status output format: text, json or tsv [text]", on_format);
+  command_option(&program, "-c", "--control <path>", "answer control requests on unix socket <path>", on_control);
+  command_option(&program, "-O", "--metrics <path>", "write prometheus metrics to <path> periodically", on_metrics);
+  command_option(&program, "-p", "--pidfile <path>", "write pid to <path>", on_pidfile);
+  command_option(&program, "-m", "--mon-pidfile <path>", "write mon(1) pid to <path>", on_mon_pidfile);
+  command_option(&program, "-P", "--prefix <str>", "add a log prefix", on_prefix);
+  command_option(&program, "-d", "--daemonize", "daemonize the program", on_daemonize);
+  command_option(&program, "-t", "--tag", "capture output, prefixing lines with the command and stream", on_tag);
+  command_option(&program, "-x", "--exec <mode>", "exec directly, via sh -c, or auto [auto]", on_exec);
+  command_option(&program, "-a", "--attempts <n>", "retry attempts within --window [10]", on_attempts);
+  command_option(&program, "-w", "--window <time>", "window restart attempts are counted within [1m]", on_window);
+  command_option(&program, "-X", "--max-rss <size>", "restart when resident memory exceeds <size>", on_max_rss);
+  command_option(&program, "-C", "--max-cpu <percent>", "restart when cpu usage exceeds <percent> for --max-cpu-for", on_max_cpu);
+  command_option(&program, "-F", "--max-cpu-for <time>", "time cpu usage may exceed --max-cpu [30s]", on_max_cpu_for);
+  command_option(&program, "-n", "--notify", "wait for READY=1 on NOTIFY_SOCKET before the child is ready", on_notify);
+  command_option(&program, "-r", "--ready <probe>", "consider the child ready once <probe> passes", on_ready);
+  command_option(&program, "-G", "--ready-timeout <time>", "time the child may take to be ready before it is killed [1m]", on_ready_timeout);
+  command_option(&program, "-L", "--listen <addr>", "pass a socket listening on tcp:<host>:<port> or unix:<path> via LISTEN_FDS", on_listen);
+  command_option(&program, "-y", "--policy <match>:<action>", "restart exit codes or signals now, after a sleep, or stop", on_policy);
+  command_option(&program, "-K", "--stop-signal <sig>", "signal children are stopped with [TERM]", on_stop_signal);
+  command_option(&program, "-W", "--stop-timeout <time>", "time children may take to stop before they are killed [10s]", on_stop_timeout);
+  command_option(&program, "-D", "--drain-timeout <time>", "time the old child may drain on handover before it is killed [30s]", on_drain_timeout);
+  command_option(&program, "-H", "--health <probe>", "probe liveness with <cmd>, tcp:<host>:<port> or unix:<path>", on_health);
+  command_option(&program, "-I", "--health-interval <time>", "time between health checks [10s]", on_health_interval);
+  command_option(&program, "-J", "--health-timeout <time>", "time a health check may take [5s]", on_health_timeout);
+  command_option(&program, "-U", "--health-failures <n>", "restart after <n> consecutive failed checks [3]", on_health_failures);
+  command_option(&program, "-R", "--on-restart <cmd>", "execute <cmd> on restarts", on_restart);
+  command_option(&program, "-E", "--on-error <cmd>", "execute <cmd> on error", on_error);
+  command_option(&program, "-T", "--hook-timeout <time>", "kill hooks running longer than <time> [30s]", on_hook_timeout);
+  command_option(&program, "-N", "--max-hooks <n>", "max hooks running at once [8]", on_max_hooks);
+  command_option(&program, "-e", "--events <cmd>", "stream JSON events to the stdin of a persistent <cmd>", on_events);
+  command_parse(&program, argc, argv);
+  current(&program);
+  srandom(getpid() ^ timestamp());
+
+  if (show_status) {
+    const char *targets[COMMANDER_MAX_ARGS + 2];
+    const char *pidfile = monitors ? monitors->pidfile : defaults.pidfile;
+    int n = 0;
+    if (pidfile) targets[n++] = pidfile;
+    if (control_path) targets[n++] = control_path;
+    for (int i = 0; i < program.argc; ++i) targets[n++] = program.argv[i];
+    if (!n) error("--pidfile, --control or <pidfile|socket|dir> required");
+    exit(status_show(targets, n, status_format));
+  }
 
-  if (monitor.show_status) {
-    if (!monitor.pidfile) error("--pidfile required");
-    show_status_of(monitor.pidfile);
-    exit(0);
+  // config
+  if (config_path) {
+    config_t config;
+    options = &program;
+    if (-1 == config_read(config_path, &config)) exit(1);
+    monitor_t *loaded = load_config(config_path, &config, false);
+    while (loaded) {
+      monitor_t *next = loaded->next;
+      append(loaded);
+      loaded = next;
+    }
+    free(config.entries);
   }
 
   // command required
-  if (!program.argc) error("<cmd> required");
-  const char *cmd = program.argv[0];
+  if (!monitors) error("<cmd> required");
 
   // signals
-  signal(SIGTERM, graceful_exit);
-  signal(SIGQUIT, graceful_exit);
+  sigset_t set;
+  handled_signals(&set);
+  sigprocmask(SIG_BLOCK, &set, NULL);
+  signal(SIGPIPE, SIG_IGN);
 
   // daemonize
-  if (monitor.daemon) {
+  if (should_daemonize) {
     daemonize();
-    redirect_stdio_to(monitor.logfile);
+    redirect_stdio_to(logfile);
   }
 
   // write mon pidfile
-  if (monitor.mon_pidfile) {
-    log("write mon pid to %s", monitor.mon_pidfile);
-    write_pidfile(monitor.mon_pidfile, getpid());
+  if (mon_pidfile) {
+    log("write mon pid to %s", mon_pidfile);
+    write_pidfile(mon_pidfile, getpid());
   }
 
-  start(cmd, &monitor);
+  supervise();
 
   return 0;
 }
@@ -0,0 +1,205 @@
+//
+// mon.h
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#ifndef MON_H
+#define MON_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+#include "loop.h"
+#include "metrics.h"
+#include "health.h"
+#include "listen.h"
+#include "policy.h"
+#include "output.h"
+
+/*
+ * Exec modes.
+ */
+
+enum {
+  EXEC_AUTO,
+  EXEC_SHELL,
+  EXEC_DIRECT
+};
+
+/*
+ * Runs kept per monitor.
+ */
+
+#ifndef MON_HISTORY
+#define MON_HISTORY 16
+#endif
+
+/*
+ * Resource usage of a run.
+ */
+
+typedef struct {
+  time_t started;
+  int64_t duration;
+  int status;
+  int64_t utime;
+  int64_t stime;
+  long maxrss;
+  long minflt;
+  long majflt;
+  long nvcsw;
+  long nivcsw;
+} run_t;
+
+/*
+ * Monitor.
+ */
+
+typedef struct monitor {
+  const char *cmd;
+  char **argv;
+  int exec_mode;
+  const char *prefix;
+  const char *pidfile;
+  const char *on_error;
+  const char *on_restart;
+  int64_t hook_timeout;
+  pid_t pid;
+  pid_t last_pid;
+  loop_timer_t timer;
+  int64_t last_restart_at;
+  int64_t window;
+  int64_t *restarts;
+  int restarts_head;
+  int64_t sleep;
+  int64_t max_sleep;
+  int64_t reset_after;
+  int64_t delay;
+  int64_t started_at;
+  time_t started_time;
+  int restarts_total;
+  int exits;
+  int last_status;
+  double backoff;
+  int jitter;
+  int max_attempts;
+  int attempts;
+  bool bailed;
+  bool tag;
+  int64_t max_rss;
+  int max_cpu;
+  int64_t max_cpu_time;
+  int statm_fd;
+  int stat_fd;
+  int64_t cpu_ticks;
+  int64_t cpu_sampled_at;
+  int64_t cpu_over_since;
+  health_t health;
+  health_t ready;
+  bool notify;
+  char notify_socket[32];
+  loop_io_t notify_io;
+  int64_t ready_at;
+  loop_timer_t ready_timer;
+  int64_t ready_timeout;
+  bool restart_pending;
+  bool abandoned;
+  const char *listen[LISTEN_MAX];
+  int listen_fds[LISTEN_MAX];
+  int nlisten;
+  bool listening;
+  pid_t old_pid;
+  int64_t old_started_at;
+  time_t old_started_time;
+  loop_timer_t drain_timer;
+  int64_t drain_timeout;
+  int stop_signal;
+  int64_t stop_timeout;
+  int handovers;
+  char *definition;
+  struct source *source;
+  bool removing;
+  struct monitor *replacement;
+  policy_t policies[POLICY_MAX];
+  int npolicies;
+  bool stopped;
+  loop_timer_t kill_timer;
+  bool stopping;
+  pid_t lingering;
+  metrics_t metrics;
+  run_t runs[MON_HISTORY];
+  int runs_head;
+  run_t totals;
+  struct monitor *next;
+} monitor_t;
+
+/*
+ * Log prefix.
+ */
+
+extern const char *prefix;
+
+/*
+ * Monitors, in the order given.
+ */
+
+extern monitor_t *monitors;
+extern int nmonitors;
+
+/*
+ * Logger.
+ */
+
+#define log(fmt, args...) \
+  do { \
+    if (prefix) { \
+      output_printf("mon : %s : " fmt "\n", prefix, ##args); \
+    } else { \
+      output_printf("mon : " fmt "\n", ##args); \
+    } \
+  } while(0)
+
+/*
+ * Monitor logger, prefixed with the monitor's
+ * --prefix, or its command when several
+ * commands are supervised.
+ */
+
+#define mlog(monitor, fmt, args...) \
+  do { \
+    const char *p = monitor_prefix(monitor); \
+    if (p) { \
+      output_printf("mon : %s : " fmt "\n", p, ##args); \
+    } else { \
+      output_printf("mon : " fmt "\n", ##args); \
+    } \
+  } while(0)
+
+// prototypes
+
+const char *
+monitor_prefix(monitor_t *monitor);
+
+void
+error(const char *fmt, ...) __attribute__((noreturn));
+
+void
+terminate(monitor_t *monitor);
+
+void
+ready(monitor_t *monitor);
+
+int
+handover(monitor_t *monitor);
+
+int64_t
+timestamp();
+
+void
+json_escape(char *buf, size_t len, const char *str);
+
+#endif /* MON_H */
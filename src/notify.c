@@ -0,0 +1,110 @@
+//
+// notify.c
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "notify.h"
+
+/*
+ * Handle the sd_notify(3) datagrams sent to `monitor`,
+ * newline-delimited assignments such as "READY=1".
+ * As with NotifyAccess=main only the child itself is
+ * listened to, its credentials being checked so that
+ * neither other processes nor the old generation of
+ * a handover can mark it ready.
+ */
+
+static void
+on_message(loop_io_t *io, uint32_t events) {
+  monitor_t *monitor = io->data;
+  char buf[1024];
+  char control[CMSG_SPACE(sizeof(struct ucred))];
+  ssize_t n;
+
+  for (;;) {
+    struct iovec iov = { buf, sizeof(buf) - 1 };
+    struct msghdr msg = {
+      .msg_iov = &iov,
+      .msg_iovlen = 1,
+      .msg_control = control,
+      .msg_controllen = sizeof(control)
+    };
+
+    if (-1 == (n = recvmsg(io->fd, &msg, MSG_DONTWAIT))) return;
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || SOL_SOCKET != cmsg->cmsg_level || SCM_CREDENTIALS != cmsg->cmsg_type) continue;
+
+    struct ucred cred;
+    memcpy(&cred, CMSG_DATA(cmsg), sizeof(cred));
+    if (!monitor->pid || cred.pid != monitor->pid) continue;
+
+    buf[n] = '\0';
+    for (char *line = strtok(buf, "\n"); line; line = strtok(NULL, "\n")) {
+      if (!strcmp("READY=1", line)) {
+        if (!monitor->ready_at) ready(monitor);
+      } else if (!strncmp("STATUS=", line, 7)) {
+        mlog(monitor, "status %s", line + 7);
+      }
+    }
+  }
+}
+
+/*
+ * Bind a datagram socket in the abstract namespace
+ * for `monitor` when given --notify, its children
+ * being given its name as NOTIFY_SOCKET.
+ */
+
+void
+notify_init(monitor_t *monitor) {
+  static int id = 0;
+
+  if (!monitor->notify) return;
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  snprintf(monitor->notify_socket, sizeof(monitor->notify_socket), "@mon/%d/%d", getpid(), id++);
+  strcpy(addr.sun_path + 1, monitor->notify_socket + 1);
+
+  int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (-1 == fd) {
+    perror("socket()");
+    exit(1);
+  }
+
+  int on = 1;
+  if (-1 == setsockopt(fd, SOL_SOCKET, SO_PASSCRED, &on, sizeof(on))) {
+    perror("setsockopt()");
+    exit(1);
+  }
+
+  socklen_t len = offsetof(struct sockaddr_un, sun_path) + strlen(monitor->notify_socket);
+  if (-1 == bind(fd, (struct sockaddr *) &addr, len)) {
+    perror("bind()");
+    exit(1);
+  }
+
+  loop_add(&monitor->notify_io, fd, EPOLLIN, on_message, monitor);
+}
+
+/*
+ * Close the notify socket of `monitor`.
+ */
+
+void
+notify_close(monitor_t *monitor) {
+  if (!monitor->notify) return;
+  loop_remove(&monitor->notify_io);
+  close(monitor->notify_io.fd);
+}
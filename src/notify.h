@@ -0,0 +1,20 @@
+//
+// notify.h
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#ifndef NOTIFY_H
+#define NOTIFY_H
+
+#include "mon.h"
+
+// prototypes
+
+void
+notify_init(monitor_t *monitor);
+
+void
+notify_close(monitor_t *monitor);
+
+#endif /* NOTIFY_H */
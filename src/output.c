@@ -0,0 +1,559 @@
+//
+// output.c
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <zlib.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "loop.h"
+#include "output.h"
+
+/*
+ * Captured child stream.
+ */
+
+typedef struct stream {
+  loop_io_t io;
+  char tag[256];
+  size_t tag_len;
+  int closed;
+  size_t off;
+  size_t len;
+  char buf[OUTPUT_BUFFER];
+  struct stream *next;
+} stream_t;
+
+/*
+ * Output fd.
+ */
+
+static int out = 1;
+
+/*
+ * Logfile path, rotated once it reaches `max_size`
+ * bytes or `max_age` ms, keeping `keep` files.
+ */
+
+static const char *path = NULL;
+static off_t max_size = 0;
+static int64_t max_age = 0;
+static int keep = 5;
+static loop_timer_t age_timer;
+
+/*
+ * Compress rotated logfiles in a helper process,
+ * rotation waits while one is running.
+ */
+
+static int gzip_rotated = 0;
+static pid_t compressor = 0;
+static int rotate_pending = 0;
+
+/*
+ * Second fd of a regular logfile, opened without
+ * O_APPEND as splice() refuses such files, which
+ * data is spliced to from pipes, or -1.
+ */
+
+static int splice_fd = -1;
+
+/*
+ * Defer writes until the loop is about to wait.
+ */
+
+static int deferred = 0;
+
+/*
+ * Captured streams.
+ */
+
+static stream_t *streams = NULL;
+
+/*
+ * Streams released at EOF, reused by the next
+ * children rather than freed, so that restarts
+ * don't allocate.
+ */
+
+static stream_t *spare = NULL;
+
+/*
+ * Batched iovecs.
+ */
+
+static struct iovec iov[OUTPUT_MAX_IOV];
+static int niov = 0;
+
+/*
+ * Mon's own log lines.
+ */
+
+static char logbuf[OUTPUT_BUFFER];
+static size_t loglen = 0;
+
+/*
+ * Return the size of the logfile, counting the
+ * writes of hooks and other mon(1) processes
+ * sharing it.
+ */
+
+static off_t
+logfile_size() {
+  struct stat s;
+  if (-1 == fstat(out, &s)) return 0;
+  return s.st_size;
+}
+
+/*
+ * Write all batched iovecs.
+ */
+
+static void
+write_iov() {
+  struct iovec *v = iov;
+  int n = niov;
+
+  while (n) {
+    ssize_t written = writev(out, v, n);
+
+    if (-1 == written) {
+      if (EINTR == errno) continue;
+      break;
+    }
+
+    // skip written iovecs, advancing a partial one
+    while (n && written >= (ssize_t) v->iov_len) {
+      written -= v->iov_len;
+      v++;
+      n--;
+    }
+
+    if (n) {
+      v->iov_base = (char *) v->iov_base + written;
+      v->iov_len -= written;
+    }
+  }
+
+  niov = 0;
+  if (max_size && logfile_size() >= max_size) output_rotate();
+}
+
+/*
+ * Open the logfile at `path` onto stdout and stderr with
+ * O_APPEND, as hooks and other mon(1) processes may write
+ * to it too. Regular files also get a second fd for splice().
+ */
+
+static int
+open_logfile() {
+  int fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0755);
+  if (-1 == fd) return -1;
+
+  dup2(fd, 1);
+  dup2(fd, 2);
+  close(fd);
+  out = 1;
+
+  if (-1 != splice_fd) close(splice_fd);
+  splice_fd = -1;
+
+  struct stat s;
+  if (0 == fstat(out, &s) && S_ISREG(s.st_mode)) {
+    splice_fd = open(path, O_WRONLY | O_CLOEXEC);
+  }
+
+  return 0;
+}
+
+/*
+ * Lower the CPU and I/O priority of the calling
+ * process to idle, so that it never competes with
+ * mon or the programs supervised.
+ */
+
+static void
+idle_priority() {
+  setpriority(PRIO_PROCESS, 0, 19);
+#ifdef SYS_ioprio_set
+  // IOPRIO_WHO_PROCESS, IOPRIO_CLASS_IDLE
+  syscall(SYS_ioprio_set, 1, 0, 3 << 13);
+#endif
+}
+
+/*
+ * Gzip `src` to `src`.gz, removing `src`.
+ */
+
+static int
+gzip_file(const char *src) {
+  char dst[PATH_MAX];
+  char tmp[PATH_MAX];
+  char buf[65536];
+  ssize_t n;
+
+  if (snprintf(dst, sizeof(dst), "%s.gz", src) >= sizeof(dst)) return -1;
+  if (snprintf(tmp, sizeof(tmp), "%s.gz.tmp", src) >= sizeof(tmp)) return -1;
+
+  int fd = open(src, O_RDONLY);
+  if (-1 == fd) return -1;
+
+  gzFile gz = gzopen(tmp, "wb6");
+  if (!gz) return -1;
+
+  while ((n = read(fd, buf, sizeof(buf))) > 0) {
+    if (gzwrite(gz, buf, n) != n) return -1;
+  }
+
+  if (-1 == n || Z_OK != gzclose(gz)) return -1;
+  if (-1 == rename(tmp, dst)) return -1;
+  return unlink(src);
+}
+
+/*
+ * Compress `file` in a low priority helper process.
+ */
+
+static void
+compress_file(const char *file) {
+  pid_t pid = fork();
+
+  switch (pid) {
+    case -1:
+      perror("fork()");
+      return;
+    case 0:
+      signal(SIGTERM, SIG_DFL);
+      signal(SIGQUIT, SIG_DFL);
+      idle_priority();
+      _exit(-1 == gzip_file(file) ? 1 : 0);
+    default:
+      compressor = pid;
+  }
+}
+
+/*
+ * Rotate the logfile, renaming `path` to `path`.1,
+ * shifting older files up to `keep`, and reopening
+ * `path`. Writers never see a missing file as the
+ * renames are atomic and the new file is opened
+ * before further writes. With --log-compress rotated
+ * files are gzipped in the background, rotation
+ * being postponed while compression is in progress.
+ */
+
+void
+output_rotate() {
+  char from[PATH_MAX];
+  char to[PATH_MAX];
+  const char *ext = gzip_rotated ? ".gz" : "";
+
+  if (!path) return;
+
+  if (compressor) {
+    rotate_pending = 1;
+    return;
+  }
+
+  for (int i = keep - 1; i > 0; --i) {
+    snprintf(from, sizeof(from), "%s.%d%s", path, i, ext);
+    snprintf(to, sizeof(to), "%s.%d%s", path, i + 1, ext);
+    rename(from, to);
+  }
+
+  if (keep) {
+    snprintf(to, sizeof(to), "%s.1", path);
+    rename(path, to);
+  } else {
+    unlink(path);
+  }
+
+  if (-1 == open_logfile()) {
+    perror("open()");
+    return;
+  }
+
+  if (keep && gzip_rotated) compress_file(to);
+  if (max_age) loop_timer_start(&age_timer, max_age, 0);
+}
+
+/*
+ * Handle exit `status` of `pid` when it is the
+ * compression helper, returning 1, or 0 otherwise.
+ */
+
+int
+output_reap(pid_t pid, int status) {
+  if (!compressor || pid != compressor) return 0;
+  compressor = 0;
+
+  if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+    output_printf("mon : failed to compress %s.1\n", path);
+  }
+
+  if (rotate_pending) {
+    rotate_pending = 0;
+    output_rotate();
+  }
+
+  return 1;
+}
+
+/*
+ * Gzip rotated logfiles.
+ */
+
+void
+output_compress(int enable) {
+  gzip_rotated = enable;
+}
+
+/*
+ * Rotate the logfile after --log-max-age.
+ */
+
+static void
+on_age(loop_timer_t *timer) {
+  if (logfile_size()) output_rotate();
+  else loop_timer_start(&age_timer, max_age, 0);
+}
+
+/*
+ * Write to the logfile at `file`, rotated once it
+ * reaches `bytes` or `ms` unless 0, keeping `n`
+ * rotated files. The age timer is set up first, as
+ * writes may rotate before output_init().
+ */
+
+int
+output_file(const char *file, off_t bytes, int64_t ms, int n) {
+  path = file;
+  max_size = bytes;
+  max_age = ms;
+  keep = n;
+  loop_timer_init(&age_timer, on_age, NULL);
+  return open_logfile();
+}
+
+/*
+ * Batch `len` bytes of `buf`.
+ */
+
+static void
+push(const char *buf, size_t len) {
+  if (!len) return;
+  if (niov == OUTPUT_MAX_IOV) write_iov();
+  iov[niov].iov_base = (char *) buf;
+  iov[niov].iov_len = len;
+  niov++;
+}
+
+/*
+ * Write everything batched in a single writev(),
+ * releasing streams which reached EOF.
+ */
+
+void
+output_flush() {
+  write_iov();
+  loglen = 0;
+
+  stream_t **ptr = &streams;
+  while (*ptr) {
+    stream_t *stream = *ptr;
+    if (stream->closed) {
+      *ptr = stream->next;
+      stream->next = spare;
+      spare = stream;
+    } else {
+      ptr = &stream->next;
+    }
+  }
+}
+
+/*
+ * Write to `fd`, stdout unless changed.
+ */
+
+void
+output_init(int fd) {
+  if (!path) out = fd;
+  loop_prepare(output_flush);
+
+  if (path && max_age) loop_timer_start(&age_timer, max_age, 0);
+}
+
+/*
+ * Toggle deferring writes until the loop waits for
+ * events, so everything output during a dispatch is
+ * written at once.
+ */
+
+void
+output_defer(int defer) {
+  if (!defer) output_flush();
+  deferred = defer;
+}
+
+/*
+ * Output a formatted log line.
+ */
+
+void
+output_printf(const char *fmt, ...) {
+  va_list args;
+
+  if (loglen + 1024 > sizeof(logbuf)) output_flush();
+
+  va_start(args, fmt);
+  int n = vsnprintf(logbuf + loglen, sizeof(logbuf) - loglen, fmt, args);
+  va_end(args);
+
+  if (n < 0) return;
+  if (n >= sizeof(logbuf) - loglen) n = sizeof(logbuf) - loglen - 1;
+  push(logbuf + loglen, n);
+  loglen += n;
+
+  if (!deferred) output_flush();
+}
+
+/*
+ * Batch complete lines of `stream`, each preceded by
+ * its tag. Partial lines wait for their newline unless
+ * the buffer is full or the stream closed.
+ */
+
+static void
+batch_lines(stream_t *stream) {
+  while (stream->off < stream->len) {
+    char *start = stream->buf + stream->off;
+    size_t avail = stream->len - stream->off;
+    char *nl = memchr(start, '\n', avail);
+
+    if (!nl && !stream->closed && stream->len < sizeof(stream->buf)) break;
+
+    size_t len = nl ? nl - start + 1 : avail;
+    push(stream->tag, stream->tag_len);
+    push(start, len);
+    if (!nl) push("\n", 1);
+    stream->off += len;
+  }
+}
+
+/*
+ * Move data from the pipe of `stream` to the end of
+ * the logfile with splice() so it never passes through
+ * userspace, returning -1 when splice() fails so that
+ * the data is read and written instead. The pipe is only
+ * closed at EOF, children writing on as long as mon lives.
+ */
+
+static int
+splice_stream(stream_t *stream) {
+  // preserve ordering with batched output
+  if (niov) output_flush();
+
+  for (;;) {
+    if (-1 == lseek(splice_fd, 0, SEEK_END)) return -1;
+    ssize_t n = splice(stream->io.fd, NULL, splice_fd, NULL, OUTPUT_SPLICE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+    if (-1 == n) {
+      if (EINTR == errno) continue;
+      if (EAGAIN == errno) return 0;
+      return -1;
+    }
+
+    if (0 == n) {
+      stream->closed = 1;
+      loop_remove(&stream->io);
+      close(stream->io.fd);
+      return 0;
+    }
+
+    if (max_size && logfile_size() >= max_size) output_rotate();
+  }
+}
+
+/*
+ * Captured stream readable.
+ */
+
+static void
+on_readable(loop_io_t *io, uint32_t events) {
+  stream_t *stream = io->data;
+
+  if (!stream->tag_len && -1 != splice_fd) {
+    if (0 == splice_stream(stream)) return;
+    output_printf("mon : splice(): %s, writing instead\n", strerror(errno));
+    close(splice_fd);
+    splice_fd = -1;
+  }
+
+  // reclaim data written by the last flush
+  if (stream->off) {
+    memmove(stream->buf, stream->buf + stream->off, stream->len - stream->off);
+    stream->len -= stream->off;
+    stream->off = 0;
+  }
+
+  ssize_t n = read(io->fd, stream->buf + stream->len, sizeof(stream->buf) - stream->len);
+
+  if (-1 == n && (EAGAIN == errno || EINTR == errno)) return;
+
+  if (n <= 0) {
+    stream->closed = 1;
+    loop_remove(io);
+    close(io->fd);
+  } else {
+    stream->len += n;
+  }
+
+  if (stream->tag_len) {
+    batch_lines(stream);
+  } else {
+    push(stream->buf + stream->off, stream->len - stream->off);
+    stream->off = stream->len;
+  }
+
+  if (!deferred) output_flush();
+}
+
+/*
+ * Capture the output read from `fd`, prefixing
+ * each line with `tag` unless NULL.
+ */
+
+void
+output_watch(int fd, const char *tag) {
+  stream_t *stream = spare;
+
+  if (stream) {
+    spare = stream->next;
+  } else if (!(stream = malloc(sizeof(stream_t)))) {
+    perror("malloc()");
+    exit(1);
+  }
+
+  snprintf(stream->tag, sizeof(stream->tag), "%s", tag ? tag : "");
+  stream->tag_len = strlen(stream->tag);
+  stream->closed = 0;
+  stream->off = stream->len = 0;
+  stream->next = streams;
+  streams = stream;
+
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+  loop_add(&stream->io, fd, EPOLLIN, on_readable, stream);
+}
@@ -0,0 +1,67 @@
+//
+// output.h
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * Bytes buffered per captured stream,
+ * and for mon's own log lines.
+ */
+
+#ifndef OUTPUT_BUFFER
+#define OUTPUT_BUFFER 16384
+#endif
+
+/*
+ * Max iovecs batched before flushing.
+ */
+
+#ifndef OUTPUT_MAX_IOV
+#define OUTPUT_MAX_IOV 1024
+#endif
+
+/*
+ * Max bytes moved per splice().
+ */
+
+#ifndef OUTPUT_SPLICE
+#define OUTPUT_SPLICE 65536
+#endif
+
+// prototypes
+
+void
+output_init(int fd);
+
+int
+output_file(const char *file, off_t bytes, int64_t ms, int n);
+
+void
+output_rotate();
+
+void
+output_compress(int enable);
+
+int
+output_reap(pid_t pid, int status);
+
+void
+output_defer(int defer);
+
+void
+output_printf(const char *fmt, ...);
+
+void
+output_watch(int fd, const char *tag);
+
+void
+output_flush();
+
+#endif /* OUTPUT_H */
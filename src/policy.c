@@ -0,0 +1,152 @@
+//
+// policy.c
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include "policy.h"
+#include "ms.h"
+
+/*
+ * Signal names.
+ */
+
+static struct {
+  const char *name;
+  int sig;
+} names[] = {
+  { "HUP", SIGHUP },
+  { "INT", SIGINT },
+  { "QUIT", SIGQUIT },
+  { "ILL", SIGILL },
+  { "TRAP", SIGTRAP },
+  { "ABRT", SIGABRT },
+  { "BUS", SIGBUS },
+  { "FPE", SIGFPE },
+  { "KILL", SIGKILL },
+  { "USR1", SIGUSR1 },
+  { "SEGV", SIGSEGV },
+  { "USR2", SIGUSR2 },
+  { "PIPE", SIGPIPE },
+  { "ALRM", SIGALRM },
+  { "TERM", SIGTERM },
+  { "XCPU", SIGXCPU },
+  { "XFSZ", SIGXFSZ },
+  { "WINCH", SIGWINCH },
+  { "SYS", SIGSYS }
+};
+
+/*
+ * Return the signal named `str` such as "TERM"
+ * or "SIGTERM", or -1.
+ */
+
+int
+policy_signal(const char *str) {
+  if (!strncmp("SIG", str, 3)) str += 3;
+
+  for (int i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+    if (!strcmp(names[i].name, str)) return names[i].sig;
+  }
+
+  return -1;
+}
+
+/*
+ * Parse a number in [0, max] from `str`, or -1.
+ */
+
+static int
+number(const char *str, int max) {
+  char *end;
+  long n = strtol(str, &end, 10);
+  if (end == str || *end || n < 0 || n > max) return -1;
+  return n;
+}
+
+/*
+ * Parse `str` into `policy`, returning -1 when invalid.
+ * Rules are "<match>:<action>" where <match> is an exit
+ * code such as "0", a range of them such as "64-78", a
+ * signal name such as "SEGV", or "signal" for any, and
+ * <action> is "stop" to stop supervising, "now" to restart
+ * immediately, or a sleep to back off from, independently
+ * of other rules.
+ */
+
+int
+policy_parse(policy_t *policy, const char *str) {
+  char match[32];
+  const char *action = strrchr(str, ':');
+  if (!action || action - str >= sizeof(match)) return -1;
+
+  memcpy(match, str, action - str);
+  match[action - str] = '\0';
+  action++;
+
+  policy->delay = 0;
+  policy->sleep = 0;
+
+  // action
+  if (!strcmp("stop", action)) {
+    policy->action = POLICY_STOP;
+  } else if (!strcmp("now", action)) {
+    policy->action = POLICY_NOW;
+  } else {
+    policy->action = POLICY_BACKOFF;
+    policy->sleep = string_to_milliseconds(action);
+    if (policy->sleep <= 0) return -1;
+  }
+
+  // any signal
+  if (!strcmp("signal", match)) {
+    policy->signal = 1;
+    policy->lo = 1;
+    policy->hi = NSIG - 1;
+    return 0;
+  }
+
+  // signal
+  int sig = policy_signal(match);
+  if (-1 != sig) {
+    policy->signal = 1;
+    policy->lo = policy->hi = sig;
+    return 0;
+  }
+
+  // exit codes
+  policy->signal = 0;
+  char *dash = strchr(match, '-');
+  if (dash) {
+    *dash = '\0';
+    policy->lo = number(match, 255);
+    policy->hi = number(dash + 1, 255);
+  } else {
+    policy->lo = policy->hi = number(match, 255);
+  }
+
+  if (-1 == policy->lo || -1 == policy->hi || policy->lo > policy->hi) return -1;
+  return 0;
+}
+
+/*
+ * Return the first of the `n` `policies` matching
+ * wait `status`, or NULL.
+ */
+
+policy_t *
+policy_match(policy_t *policies, int n, int status) {
+  int signal = WIFSIGNALED(status);
+  int code = signal ? WTERMSIG(status) : WEXITSTATUS(status);
+
+  for (int i = 0; i < n; ++i) {
+    policy_t *p = &policies[i];
+    if (p->signal == signal && code >= p->lo && code <= p->hi) return p;
+  }
+
+  return NULL;
+}
@@ -0,0 +1,55 @@
+//
+// policy.h
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#ifndef POLICY_H
+#define POLICY_H
+
+#include <stdint.h>
+
+/*
+ * Max --policy rules per monitor.
+ */
+
+#ifndef POLICY_MAX
+#define POLICY_MAX 16
+#endif
+
+/*
+ * Policy actions.
+ */
+
+enum {
+  POLICY_BACKOFF,
+  POLICY_NOW,
+  POLICY_STOP
+};
+
+/*
+ * Restart policy of exit codes or signals in
+ * [lo, hi], with the backoff state of its class.
+ */
+
+typedef struct {
+  int signal;
+  int lo;
+  int hi;
+  int action;
+  int64_t sleep;
+  int64_t delay;
+} policy_t;
+
+// prototypes
+
+int
+policy_signal(const char *str);
+
+int
+policy_parse(policy_t *policy, const char *str);
+
+policy_t *
+policy_match(policy_t *policies, int n, int status);
+
+#endif /* POLICY_H */
@@ -0,0 +1,159 @@
+//
+// spawn.c
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sched.h>
+#include "spawn.h"
+#include "listen.h"
+
+/*
+ * Stack of the child until it execs, mon
+ * being suspended meanwhile.
+ */
+
+static char stack[SPAWN_STACK] __attribute__((aligned(16)));
+
+/*
+ * Environment of the child, environ followed by
+ * the variables of the monitor being spawned.
+ */
+
+static char **envp = NULL;
+static size_t envcap = 0;
+static char notify_socket[64];
+static char listen_fds[32];
+static char listen_pid[32];
+
+/*
+ * Child being spawned.
+ */
+
+typedef struct {
+  monitor_t *monitor;
+  int out;
+  int err;
+} child_t;
+
+/*
+ * Report the failed `call` and exit, leaving
+ * the stdio buffers and atexit() handlers shared
+ * with mon alone.
+ */
+
+static void
+fail(const char *call) {
+  dprintf(2, "%s: %s\n", call, strerror(errno));
+  _exit(1);
+}
+
+/*
+ * Build the environment of the child of `monitor`,
+ * which fills in LISTEN_PID itself. Only the first
+ * spawn allocates, mon's environment never changing.
+ */
+
+static void
+build_env(monitor_t *monitor) {
+  size_t len = 0;
+  size_t n = 0;
+
+  while (environ[len]) len++;
+
+  if (len + 4 > envcap) {
+    envcap = len + 4;
+    envp = realloc(envp, envcap * sizeof(char *));
+    if (!envp) {
+      perror("realloc()");
+      exit(1);
+    }
+  }
+
+  for (size_t i = 0; i < len; ++i) {
+    char *var = environ[i];
+    if (monitor->notify && !strncmp("NOTIFY_SOCKET=", var, 14)) continue;
+    if (monitor->nlisten && !strncmp("LISTEN_FDS=", var, 11)) continue;
+    if (monitor->nlisten && !strncmp("LISTEN_PID=", var, 11)) continue;
+    envp[n++] = var;
+  }
+
+  if (monitor->notify) {
+    snprintf(notify_socket, sizeof(notify_socket), "NOTIFY_SOCKET=%s", monitor->notify_socket);
+    envp[n++] = notify_socket;
+  }
+
+  if (monitor->nlisten) {
+    snprintf(listen_fds, sizeof(listen_fds), "LISTEN_FDS=%d", monitor->nlisten);
+    envp[n++] = listen_fds;
+    envp[n++] = listen_pid;
+  }
+
+  envp[n] = NULL;
+}
+
+/*
+ * Exec the child in its own process group, with
+ * signals unblocked and reset. It shares mon's
+ * memory, so nothing here may allocate.
+ */
+
+static int
+exec_child(void *data) {
+  child_t *child = data;
+  monitor_t *monitor = child->monitor;
+  sigset_t set;
+
+  sigemptyset(&set);
+  sigprocmask(SIG_SETMASK, &set, NULL);
+  signal(SIGTERM, SIG_DFL);
+  signal(SIGQUIT, SIG_DFL);
+  signal(SIGPIPE, SIG_DFL);
+  setpgid(0, 0);
+
+  // before the sockets may take the fds of the pipes
+  if (-1 != child->out) {
+    dup2(child->out, 1);
+    dup2(child->err, 2);
+  }
+
+  if (monitor->nlisten) {
+    listen_pass(monitor);
+    snprintf(listen_pid, sizeof(listen_pid), "LISTEN_PID=%d", getpid());
+  }
+
+  // direct
+  if (monitor->argv) {
+    execvpe(monitor->argv[0], monitor->argv, envp);
+    if (EXEC_DIRECT == monitor->exec_mode || ENOENT != errno) fail("execvp()");
+  }
+
+  // shell builtins and the like fall through
+  char *argv[] = { "sh", "-c", (char *) monitor->cmd, NULL };
+  execve("/bin/sh", argv, envp);
+  fail("execve()");
+  return 1;
+}
+
+/*
+ * Spawn the child of `monitor` with `out` and `err`
+ * as its stdout and stderr unless -1, returning its
+ * pid or -1. Rather than fork() the child shares
+ * mon's memory until it execs, as with vfork(), so
+ * spawning costs the same however large mon grows.
+ * posix_spawn(3) does the same, but can't tell the
+ * child its own pid for LISTEN_PID.
+ */
+
+pid_t
+spawn_child(monitor_t *monitor, int out, int err) {
+  child_t child = { monitor, out, err };
+  build_env(monitor);
+  return clone(exec_child, stack + sizeof(stack), CLONE_VM | CLONE_VFORK | SIGCHLD, &child);
+}
@@ -0,0 +1,25 @@
+//
+// spawn.h
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#ifndef SPAWN_H
+#define SPAWN_H
+
+#include "mon.h"
+
+/*
+ * Bytes of stack children run on until they exec.
+ */
+
+#ifndef SPAWN_STACK
+#define SPAWN_STACK 65536
+#endif
+
+// prototypes
+
+pid_t
+spawn_child(monitor_t *monitor, int out, int err);
+
+#endif /* SPAWN_H */
@@ -0,0 +1,414 @@
+//
+// status.c
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <glob.h>
+#include <poll.h>
+#include <limits.h>
+#include <signal.h>
+#include <libgen.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "control.h"
+#include "mon.h"
+#include "ms.h"
+#include "status.h"
+
+/*
+ * Status of a single service.
+ */
+
+typedef struct {
+  char source[PATH_MAX];
+  char service[256];
+  pid_t pid;
+  char state[16];
+  long long started;
+  long long uptime;
+  int restarts;
+  char last_exit[128];
+} record_t;
+
+/*
+ * Control socket queried.
+ */
+
+typedef struct {
+  const char *path;
+  struct sockaddr_un addr;
+  int fd;
+  int connected;
+  size_t sent;
+  int slot;
+  buffer_t res;
+  int done;
+} query_t;
+
+/*
+ * Request sent to control sockets.
+ */
+
+static const char request[] = "status\n";
+
+/*
+ * Milliseconds between attempts to connect to a
+ * control socket whose backlog is full.
+ */
+
+#define STATUS_RETRY 10
+
+/*
+ * Check if process of `pid` is alive.
+ */
+
+static int
+alive(pid_t pid) {
+  return 0 == kill(pid, 0);
+}
+
+/*
+ * Read pid `file`, returning -1 on error.
+ */
+
+static pid_t
+read_pidfile(const char *file) {
+  char buf[32] = {0};
+
+  int fd = open(file, O_RDONLY, 0);
+  if (fd < 0) return -1;
+
+  ssize_t n = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  if (n <= 0) return -1;
+
+  return atoi(buf);
+}
+
+/*
+ * Fill `r` with the status of `pidfile`, using
+ * its mtime as the start time.
+ */
+
+static void
+pidfile_record(const char *pidfile, record_t *r) {
+  struct stat s;
+  char name[PATH_MAX];
+
+  memset(r, 0, sizeof(*r));
+  snprintf(r->source, sizeof(r->source), "%s", pidfile);
+  snprintf(name, sizeof(name), "%s", pidfile);
+  snprintf(r->service, sizeof(r->service), "%s", basename(name));
+  char *ext = strstr(r->service, ".pid");
+  if (ext && !ext[4]) *ext = '\0';
+  r->restarts = -1;
+  snprintf(r->last_exit, sizeof(r->last_exit), "-");
+
+  pid_t pid;
+  if (stat(pidfile, &s) < 0 || -1 == (pid = read_pidfile(pidfile))) {
+    snprintf(r->state, sizeof(r->state), "error");
+    snprintf(r->last_exit, sizeof(r->last_exit), "%s", strerror(errno));
+    return;
+  }
+
+  struct timeval t;
+  gettimeofday(&t, NULL);
+  r->pid = pid;
+
+  if (alive(pid)) {
+    snprintf(r->state, sizeof(r->state), "alive");
+    r->started = s.st_mtime;
+    r->uptime = (long long) (t.tv_sec - s.st_mtime) * 1000;
+  } else {
+    snprintf(r->state, sizeof(r->state), "dead");
+  }
+}
+
+/*
+ * Parse a tab-separated status `line` of control socket `path`.
+ */
+
+static int
+control_record(const char *path, char *line, record_t *r) {
+  char *fields[7];
+  int n = 0;
+  char *save;
+
+  for (char *f = strtok_r(line, "\t", &save); f && n < 7; f = strtok_r(NULL, "\t", &save)) {
+    fields[n++] = f;
+  }
+
+  if (n < 7) return -1;
+
+  memset(r, 0, sizeof(*r));
+  snprintf(r->source, sizeof(r->source), "%s", path);
+  snprintf(r->service, sizeof(r->service), "%s", fields[0]);
+  r->pid = atoi(fields[1]);
+  snprintf(r->state, sizeof(r->state), "%s", fields[2]);
+  r->started = atoll(fields[3]);
+  r->uptime = atoll(fields[4]);
+  r->restarts = atoi(fields[5]);
+  snprintf(r->last_exit, sizeof(r->last_exit), "%s", fields[6]);
+  return 0;
+}
+
+/*
+ * Output `r` in `format`.
+ */
+
+static void
+print_record(record_t *r, int format) {
+  char source[PATH_MAX * 2];
+  char service[sizeof(r->service) * 2];
+  char last_exit[sizeof(r->last_exit) * 2];
+
+  switch (format) {
+    case STATUS_JSON:
+      json_escape(source, sizeof(source), r->source);
+      json_escape(service, sizeof(service), r->service);
+      json_escape(last_exit, sizeof(last_exit), r->last_exit);
+      printf("{\"source\":\"%s\",\"service\":\"%s\",\"pid\":%d,\"state\":\"%s\""
+        ",\"started\":%lld,\"uptime\":%lld,\"restarts\":%d,\"last_exit\":\"%s\"}\n"
+        , source
+        , service
+        , r->pid
+        , r->state
+        , r->started
+        , r->uptime
+        , r->restarts
+        , last_exit);
+      break;
+    case STATUS_TSV:
+      printf("%s\t%s\t%d\t%s\t%lld\t%lld\t%d\t%s\n"
+        , r->source
+        , r->service
+        , r->pid
+        , r->state
+        , r->started
+        , r->uptime
+        , r->restarts
+        , r->last_exit);
+      break;
+    default: {
+      int running = !strcmp("alive", r->state) || !strcmp("running", r->state);
+      const char *color = running ? "32" : "31";
+      if (!strcmp("restarting", r->state) || !strcmp("starting", r->state)) color = "33";
+      char uptime[MS_LEN];
+      milliseconds_to_long_string_r(r->uptime, uptime, sizeof(uptime));
+
+      // pidfile
+      if (-1 == r->restarts) {
+        if (!strcmp("error", r->state)) {
+          printf("\e[90m%s\e[0m : \e[31merror\e[0m : %s\n", r->source, r->last_exit);
+        } else if (running) {
+          printf("\e[90m%d\e[0m : \e[32malive\e[0m : uptime %s\e[m\n", r->pid, uptime);
+        } else {
+          printf("\e[90m%d\e[0m : \e[31mdead\e[0m\n", r->pid);
+        }
+      } else {
+        printf("\e[90m%s\e[0m : %d : \e[%sm%s\e[0m : uptime %s : %d restarts : last %s\n"
+          , r->service
+          , r->pid
+          , color
+          , r->state
+          , running ? uptime : "-"
+          , r->restarts
+          , r->last_exit);
+      }
+    }
+  }
+}
+
+/*
+ * Check if `path` is a unix socket.
+ */
+
+static int
+is_socket(const char *path) {
+  struct stat s;
+  return 0 == stat(path, &s) && S_ISSOCK(s.st_mode);
+}
+
+/*
+ * Create the socket of query `q` without blocking,
+ * returning -1 on error.
+ */
+
+static int
+query_start(query_t *q) {
+  q->addr.sun_family = AF_UNIX;
+  if (strlen(q->path) >= sizeof(q->addr.sun_path)) return -1;
+  strcpy(q->addr.sun_path, q->path);
+
+  q->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  return q->fd;
+}
+
+/*
+ * Connect query `q` and send as much of the request
+ * as the socket takes, returning -1 on error. While
+ * the backlog of mon is full connecting fails with
+ * EAGAIN, and is retried on the next call.
+ */
+
+static int
+query_send(query_t *q) {
+  if (!q->connected) {
+    if (-1 == connect(q->fd, (struct sockaddr *) &q->addr, sizeof(q->addr))) {
+      if (EAGAIN == errno || EINPROGRESS == errno || EALREADY == errno) return 0;
+      if (EISCONN != errno) return -1;
+    }
+    q->connected = 1;
+  }
+
+  while (q->sent < sizeof(request) - 1) {
+    ssize_t n = send(q->fd, request + q->sent, sizeof(request) - 1 - q->sent, MSG_NOSIGNAL);
+    if (-1 == n) return EAGAIN == errno ? 0 : -1;
+    q->sent += n;
+  }
+
+  return 0;
+}
+
+/*
+ * Output the status of `targets` in `format`, returning 1 when
+ * any could not be read, 0 otherwise. Targets are pidfiles,
+ * control sockets, directories containing either, or globs.
+ * Control sockets are queried concurrently.
+ */
+
+int
+status_show(const char **targets, int n, int format) {
+  glob_t g = {0};
+  int flags = 0;
+  int ret = 0;
+  char pattern[PATH_MAX];
+  struct stat s;
+
+  // expand targets
+  for (int i = 0; i < n; ++i) {
+    if (0 == stat(targets[i], &s) && S_ISDIR(s.st_mode)) {
+      snprintf(pattern, sizeof(pattern), "%s/*.pid", targets[i]);
+      glob(pattern, flags, NULL, &g);
+      flags |= GLOB_APPEND;
+      snprintf(pattern, sizeof(pattern), "%s/*.sock", targets[i]);
+      glob(pattern, flags, NULL, &g);
+    } else {
+      glob(targets[i], flags | GLOB_NOCHECK, NULL, &g);
+    }
+    flags |= GLOB_APPEND;
+  }
+
+  size_t count = g.gl_pathc;
+  query_t *queries = calloc(count, sizeof(query_t));
+  struct pollfd *fds = calloc(count, sizeof(struct pollfd));
+  if (count && (!queries || !fds)) error("out of memory");
+
+  // connect to every socket first
+  int pending = 0;
+  for (size_t i = 0; i < count; ++i) {
+    queries[i].path = g.gl_pathv[i];
+    queries[i].fd = -1;
+    if (!is_socket(queries[i].path)) continue;
+    if (-1 != query_start(&queries[i])) pending++;
+    else queries[i].done = 1;
+  }
+
+  // send requests and read responses as the sockets allow
+  int64_t deadline = timestamp() + STATUS_TIMEOUT;
+  while (pending) {
+    int nfds = 0;
+    int retry = 0;
+    for (size_t i = 0; i < count; ++i) {
+      query_t *q = &queries[i];
+      q->slot = -1;
+      if (-1 == q->fd || q->done) continue;
+
+      if (-1 == query_send(q)) {
+        q->done = 1;
+        pending--;
+        continue;
+      }
+
+      if (!q->connected) {
+        retry = 1;
+        continue;
+      }
+
+      q->slot = nfds;
+      fds[nfds].fd = q->fd;
+      fds[nfds].events = q->sent < sizeof(request) - 1 ? POLLOUT : POLLIN;
+      nfds++;
+    }
+
+    if (!pending) break;
+    int64_t timeout = deadline - timestamp();
+    if (retry && timeout > STATUS_RETRY) timeout = STATUS_RETRY;
+    if (timeout <= 0 || (poll(fds, nfds, timeout) <= 0 && !retry)) break;
+
+    for (size_t i = 0; i < count; ++i) {
+      query_t *q = &queries[i];
+      if (-1 == q->slot || !fds[q->slot].revents) continue;
+      if (q->sent < sizeof(request) - 1) continue;
+
+      char chunk[4096];
+      ssize_t len = read(q->fd, chunk, sizeof(chunk));
+      if (-1 == len && EAGAIN == errno) continue;
+      if (len > 0) {
+        buffer_printf(&q->res, "%.*s", (int) len, chunk);
+        continue;
+      }
+
+      q->done = 1;
+      pending--;
+    }
+  }
+
+  // output in the order given
+  for (size_t i = 0; i < count; ++i) {
+    query_t *q = &queries[i];
+    record_t r;
+
+    if (!is_socket(q->path)) {
+      pidfile_record(q->path, &r);
+      if (!strcmp("error", r.state)) ret = 1;
+      print_record(&r, format);
+      continue;
+    }
+
+    if (-1 != q->fd) close(q->fd);
+
+    if (!q->done || !q->res.data) {
+      memset(&r, 0, sizeof(r));
+      snprintf(r.source, sizeof(r.source), "%s", q->path);
+      snprintf(r.service, sizeof(r.service), "-");
+      snprintf(r.state, sizeof(r.state), "error");
+      snprintf(r.last_exit, sizeof(r.last_exit), q->done ? "unreachable" : "timeout");
+      r.restarts = -1;
+      print_record(&r, format);
+      ret = 1;
+      continue;
+    }
+
+    char *save;
+    for (char *line = strtok_r(q->res.data, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+      if (0 == control_record(q->path, line, &r)) print_record(&r, format);
+    }
+
+    free(q->res.data);
+  }
+
+  free(queries);
+  free(fds);
+  globfree(&g);
+  return ret;
+}
@@ -0,0 +1,33 @@
+//
+// status.h
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#ifndef STATUS_H
+#define STATUS_H
+
+/*
+ * Status output formats.
+ */
+
+enum {
+  STATUS_TEXT,
+  STATUS_JSON,
+  STATUS_TSV
+};
+
+/*
+ * Max time waited for control sockets in ms.
+ */
+
+#ifndef STATUS_TIMEOUT
+#define STATUS_TIMEOUT 2000
+#endif
+
+// prototypes
+
+int
+status_show(const char **targets, int n, int format);
+
+#endif /* STATUS_H */
@@ -0,0 +1,173 @@
+//
+// watchdog.c
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "watchdog.h"
+
+/*
+ * Sampling timer.
+ */
+
+static loop_timer_t timer;
+
+/*
+ * Page size and clock ticks per second.
+ */
+
+static long page_size;
+static long ticks;
+
+/*
+ * Read the resident set size of `monitor` in bytes,
+ * returning -1 on error.
+ */
+
+static int64_t
+sample_rss(monitor_t *monitor) {
+  char buf[128];
+  ssize_t n = pread(monitor->statm_fd, buf, sizeof(buf) - 1, 0);
+  if (n <= 0) return -1;
+  buf[n] = '\0';
+
+  long size, resident;
+  if (2 != sscanf(buf, "%ld %ld", &size, &resident)) return -1;
+  return (int64_t) resident * page_size;
+}
+
+/*
+ * Read the user and system CPU ticks of `monitor`,
+ * returning -1 on error.
+ */
+
+static int64_t
+sample_cpu(monitor_t *monitor) {
+  char buf[1024];
+  ssize_t n = pread(monitor->stat_fd, buf, sizeof(buf) - 1, 0);
+  if (n <= 0) return -1;
+  buf[n] = '\0';
+
+  // skip "pid (comm)", comm may contain spaces
+  char *p = strrchr(buf, ')');
+  if (!p) return -1;
+
+  unsigned long long utime, stime;
+  if (2 != sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime)) {
+    return -1;
+  }
+
+  return utime + stime;
+}
+
+/*
+ * Sample `monitor` at `now`.
+ */
+
+static void
+sample(monitor_t *monitor, int64_t now) {
+  if (monitor->stopping) return;
+
+  // memory
+  if (monitor->max_rss) {
+    int64_t rss = sample_rss(monitor);
+    if (rss > monitor->max_rss) {
+      mlog(monitor, "rss %lldkb exceeds --max-rss, restarting", (long long) rss / 1024);
+      monitor->metrics.watchdog_rss++;
+      terminate(monitor);
+      return;
+    }
+  }
+
+  // cpu
+  if (monitor->max_cpu) {
+    int64_t cpu = sample_cpu(monitor);
+    if (-1 == cpu) return;
+
+    if (monitor->cpu_sampled_at && now > monitor->cpu_sampled_at) {
+      int64_t ms = (cpu - monitor->cpu_ticks) * 1000 / ticks;
+      int percent = ms * 100 / (now - monitor->cpu_sampled_at);
+
+      if (percent <= monitor->max_cpu) {
+        monitor->cpu_over_since = 0;
+      } else if (!monitor->cpu_over_since) {
+        monitor->cpu_over_since = monitor->cpu_sampled_at;
+      } else if (now - monitor->cpu_over_since >= monitor->max_cpu_time) {
+        mlog(monitor, "cpu %d%% exceeds --max-cpu, restarting", percent);
+        monitor->metrics.watchdog_cpu++;
+        terminate(monitor);
+      }
+    }
+
+    monitor->cpu_ticks = cpu;
+    monitor->cpu_sampled_at = now;
+  }
+}
+
+/*
+ * Sample every watched child.
+ */
+
+static void
+on_sample(loop_timer_t *timer) {
+  int64_t now = timestamp();
+  for (monitor_t *m = monitors; m; m = m->next) {
+    if (m->pid && -1 != m->statm_fd) sample(m, now);
+  }
+}
+
+/*
+ * Initialize the sampling timer.
+ */
+
+void
+watchdog_init() {
+  page_size = sysconf(_SC_PAGESIZE);
+  ticks = sysconf(_SC_CLK_TCK);
+  loop_timer_init(&timer, on_sample, NULL);
+}
+
+/*
+ * Open the /proc files of the child of `monitor` once,
+ * so that each sample costs a pread() per file.
+ */
+
+void
+watchdog_watch(monitor_t *monitor) {
+  char path[64];
+
+  if (!monitor->max_rss && !monitor->max_cpu) return;
+
+  // sample every WATCHDOG_INTERVAL once any child is watched
+  if (!timer.slot) loop_timer_start(&timer, WATCHDOG_INTERVAL, WATCHDOG_INTERVAL);
+
+  snprintf(path, sizeof(path), "/proc/%d/statm", monitor->pid);
+  monitor->statm_fd = open(path, O_RDONLY | O_CLOEXEC);
+  snprintf(path, sizeof(path), "/proc/%d/stat", monitor->pid);
+  monitor->stat_fd = open(path, O_RDONLY | O_CLOEXEC);
+
+  if (-1 == monitor->statm_fd || -1 == monitor->stat_fd) {
+    mlog(monitor, "failed to open /proc/%d, not watching", monitor->pid);
+    watchdog_unwatch(monitor);
+  }
+
+  monitor->cpu_ticks = 0;
+  monitor->cpu_sampled_at = 0;
+  monitor->cpu_over_since = 0;
+}
+
+/*
+ * Close the /proc files of the child of `monitor`.
+ */
+
+void
+watchdog_unwatch(monitor_t *monitor) {
+  if (-1 != monitor->statm_fd) close(monitor->statm_fd);
+  if (-1 != monitor->stat_fd) close(monitor->stat_fd);
+  monitor->statm_fd = monitor->stat_fd = -1;
+}
@@ -0,0 +1,31 @@
+//
+// watchdog.h
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include "mon.h"
+
+/*
+ * Interval children are sampled at in ms.
+ */
+
+#ifndef WATCHDOG_INTERVAL
+#define WATCHDOG_INTERVAL 1000
+#endif
+
+// prototypes
+
+void
+watchdog_init();
+
+void
+watchdog_watch(monitor_t *monitor);
+
+void
+watchdog_unwatch(monitor_t *monitor);
+
+#endif /* WATCHDOG_H */
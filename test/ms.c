@@ -0,0 +1,132 @@
+//
+// ms.c
+//
+// Copyright (c) 2012 TJ Holowaychuk <tj@vision-media.ca>
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "ms.h"
+
+#define MS_SEC (long long)1000
+#define MS_MIN 60 * MS_SEC
+#define MS_HOUR 60 * MS_MIN
+#define MS_DAY 24 * MS_HOUR
+#define MS_YEAR 52 * 7 * MS_DAY
+
+void
+equal(char *a, char *b) {
+  if (strcmp(a, b)) {
+    printf("expected: %s\n", a);
+    printf("actual: %s\n", b);
+    exit(1);
+  }
+}
+
+void
+test_string_to_microseconds() {
+  assert(string_to_microseconds("") == -1);
+  assert(string_to_microseconds("s") == -1);
+  assert(string_to_microseconds("hey") == -1);
+  assert(string_to_microseconds("5000") == 5000);
+  assert(string_to_microseconds("1ms") == 1000);
+  assert(string_to_microseconds("5ms") == 5000);
+  assert(string_to_microseconds("1s") == 1000000);
+  assert(string_to_microseconds("5s") == 5000000);
+  assert(string_to_microseconds("1m") == 60000000);
+  assert(string_to_microseconds("1h") == 3600000000);
+  assert(string_to_microseconds("2d") == 2 * 24 * 3600000000);
+}
+
+void
+test_string_to_milliseconds() {
+  assert(string_to_milliseconds("") == -1);
+  assert(string_to_milliseconds("s") == -1);
+  assert(string_to_milliseconds("hey") == -1);
+  assert(string_to_milliseconds("5000") == 5000);
+  assert(string_to_milliseconds("1ms") == 1);
+  assert(string_to_milliseconds("5ms") == 5);
+  assert(string_to_milliseconds("1s") == 1000);
+  assert(string_to_milliseconds("5s") == 5000);
+  assert(string_to_milliseconds("1m") == 60 * 1000);
+  assert(string_to_milliseconds("1h") == 60 * 60 * 1000);
+  assert(string_to_milliseconds("1d") == 24 * 60 * 60 * 1000);
+}
+
+void
+test_string_to_seconds() {
+  assert(string_to_seconds("") == -1);
+  assert(string_to_seconds("s") == -1);
+  assert(string_to_seconds("hey") == -1);
+  assert(string_to_seconds("5000") == 5);
+  assert(string_to_seconds("1ms") == 0);
+  assert(string_to_seconds("5ms") == 0);
+  assert(string_to_seconds("1s") == 1);
+  assert(string_to_seconds("5s") == 5);
+  assert(string_to_seconds("1m") == 60);
+  assert(string_to_seconds("1h") == 60 * 60);
+  assert(string_to_seconds("1d") == 24 * 60 * 60);
+}
+
+void
+test_milliseconds_to_string() {
+  equal("500ms", milliseconds_to_string(500));
+  equal("5s", milliseconds_to_string(5000));
+  equal("2s", milliseconds_to_string(2500));
+  equal("1m", milliseconds_to_string(MS_MIN));
+  equal("5m", milliseconds_to_string(5 * MS_MIN));
+  equal("1h", milliseconds_to_string(MS_HOUR));
+  equal("2d", milliseconds_to_string(2 * MS_DAY));
+  equal("2w", milliseconds_to_string(15 * MS_DAY));
+  equal("3y", milliseconds_to_string(3 * MS_YEAR));
+}
+
+void
+test_milliseconds_to_long_string() {
+  equal("less than one second", milliseconds_to_long_string(500));
+  equal("5 seconds", milliseconds_to_long_string(5000));
+  equal("2 seconds", milliseconds_to_long_string(2500));
+  equal("1 minute", milliseconds_to_long_string(MS_MIN));
+  equal("5 minutes", milliseconds_to_long_string(5 * MS_MIN));
+  equal("1 hour", milliseconds_to_long_string(MS_HOUR));
+  equal("2 days", milliseconds_to_long_string(2 * MS_DAY));
+  equal("2 weeks", milliseconds_to_long_string(15 * MS_DAY));
+  equal("1 year", milliseconds_to_long_string(MS_YEAR));
+  equal("3 years", milliseconds_to_long_string(3 * MS_YEAR));
+}
+
+void
+test_milliseconds_to_string_r() {
+  char buf[MS_LEN];
+  equal("500ms", milliseconds_to_string_r(500, buf, sizeof(buf)));
+  equal("2w", milliseconds_to_string_r(15 * MS_DAY, buf, sizeof(buf)));
+  equal("-9223372036854775807ms", milliseconds_to_string_r(-9223372036854775807LL, buf, sizeof(buf)));
+  equal("12", milliseconds_to_string_r(123, buf, 3));
+  assert(buf == milliseconds_to_string_r(5000, buf, sizeof(buf)));
+}
+
+void
+test_milliseconds_to_long_string_r() {
+  char buf[MS_LEN];
+  equal("less than one second", milliseconds_to_long_string_r(500, buf, sizeof(buf)));
+  equal("1 minute", milliseconds_to_long_string_r(MS_MIN, buf, sizeof(buf)));
+  equal("3 years", milliseconds_to_long_string_r(3 * MS_YEAR, buf, sizeof(buf)));
+  equal("293274701 years", milliseconds_to_long_string_r(9223372036854775807LL, buf, sizeof(buf)));
+  equal("less", milliseconds_to_long_string_r(500, buf, 5));
+  assert(buf == milliseconds_to_long_string_r(5000, buf, sizeof(buf)));
+}
+
+int
+main(){
+  test_string_to_microseconds();
+  test_string_to_milliseconds();
+  test_string_to_seconds();
+  test_milliseconds_to_string();
+  test_milliseconds_to_long_string();
+  test_milliseconds_to_string_r();
+  test_milliseconds_to_long_string_r();
+  printf("\n  \e[32m\u2713 \e[90mok\e[0m\n\n");
+  return 0;
+}